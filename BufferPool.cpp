@@ -0,0 +1,42 @@
+#include "BufferPool.h"
+
+BufferPool::~BufferPool()
+{
+  for (int i = 0; i < BUFFER_POOL_CLASSES; i++)
+  {
+    for (auto pBuffer : mFree[i]) delete[] pBuffer;
+  }
+}
+
+size_t BufferPool::capacity(size_t size)
+{
+  int i = sizeClass(size);
+  return i < 0 ? 0 : (size_t)1 << (BUFFER_POOL_MIN_SHIFT + i);
+}
+
+Byte* BufferPool::get(size_t size)
+{
+  int i = sizeClass(size);
+  if (i < 0) return NULL;
+  if (mFree[i].empty()) return new Byte[capacity(size)];
+  Byte* pBuffer = mFree[i].back();
+  mFree[i].pop_back();
+  return pBuffer;
+}
+
+void BufferPool::put(Byte* pBuffer, size_t size)
+{
+  int i = sizeClass(size);
+  if (mFree[i].size() < BUFFER_POOL_KEEP) mFree[i].push_back(pBuffer);
+  else delete[] pBuffer;
+}
+
+int BufferPool::sizeClass(size_t size)
+{
+  int i = 0;
+  while (((size_t)1 << (BUFFER_POOL_MIN_SHIFT + i)) < size)
+  {
+    if (++i == BUFFER_POOL_CLASSES) return -1;
+  }
+  return i;
+}
@@ -0,0 +1,48 @@
+#ifndef BUFFERPOOL_H
+#define BUFFERPOOL_H
+
+#include <vector>
+#include "types.h"
+
+#define BUFFER_POOL_MIN_SHIFT  7 // mažiausias buferis – 2^7 baitų
+#define BUFFER_POOL_CLASSES   11 // 128 B, 256 B, ..., 128 KiB
+#define BUFFER_POOL_KEEP       4 // kiek laisvų kiekvieno dydžio buferių laikyti
+
+/**
+ * Baitų buferių atsargos.
+ *
+ * Buferių dydžiai – dvejeto laipsniai. Grąžintas buferis nedidelėje
+ * atsargoje laukia kito to paties dydžio prašymo, todėl dažnai gaunant ir
+ * atiduodant buferius atmintis iš sistemos neprašoma. Kad laisvi buferiai
+ * neužimtų daug atminties, kiekvieno dydžio laikoma ne daugiau nei
+ * BUFFER_POOL_KEEP.
+ */
+class BufferPool
+{
+  private:
+    vector<Byte*> mFree[BUFFER_POOL_CLASSES];
+
+  public:
+    ~BufferPool();
+
+    /**
+     * @return tikrasis buferio, skiriamo size baitų prašymui, dydis arba 0,
+     *         jei toks buferis per didelis
+     */
+    static size_t capacity(size_t size);
+
+    /**
+     * @return bent size baitų buferis arba NULL, jei size per didelis
+     */
+    Byte*         get(size_t size);
+
+    /**
+     * Grąžina buferį, gautą get(size).
+     */
+    void          put(Byte* pBuffer, size_t size);
+
+  private:
+    static int    sizeClass(size_t size);
+};
+
+#endif
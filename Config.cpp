@@ -0,0 +1,20 @@
+#include "Config.h"
+#include "LinkLayer.h"
+#include "NetworkLayer.h"
+#include "Reassembly.h"
+#include "RouteWorker.h"
+
+Config::Config():
+  frameQueueSize(MAX_FRAME_QUEUE_SIZE),
+  controlQueueSize(MAX_CONTROL_QUEUE_SIZE),
+  pendingQueueSize(MAX_PENDING_PACKETS),
+  mtu(MAX_MTU),
+  reassemblyMemory(MAX_REASSEMBLY_MEMORY),
+  spfDelay(SPF_DELAY),
+  spfHold(SPF_HOLD),
+  spfMaxHold(SPF_MAX_HOLD),
+  areaPrefix(AREA_PREFIX),
+  spfThreads(SPF_THREADS),
+  helloInterval(HELLO_INTERVAL),
+  helloMultiplier(HELLO_MULTIPLIER)
+{ }
@@ -0,0 +1,31 @@
+#ifndef CONFIG_H
+#define CONFIG_H
+
+/**
+ * Mazgo nustatymai, nurodomi jį paleidžiant (žr. node.cpp).
+ * Numatytosios reikšmės – atitinkamų lygių konstantos.
+ */
+struct Config
+{
+  unsigned frameQueueSize;   // kanalinio lygio duomenų kadrų eilės ilgis
+  unsigned controlQueueSize; // kanalinio lygio valdymo kadrų eilės ilgis
+  unsigned pendingQueueSize; // kiek paketų tinklo lygis laiko kiekvienam
+                             // kaimynui, kol kanalinio lygio eilė pilna
+  unsigned mtu;              // didžiausias šio mazgo kanalais siunčiamo
+                             // paketo ilgis
+  unsigned reassemblyMemory; // kiek baitų daugiausiai skiriama fragmentais
+                             // gaunamų paketų surinkimui
+  unsigned spfDelay;         // maršrutų skaičiavimo ribojimas (žr.
+  unsigned spfHold;          // NetworkLayer.h), milisekundėmis
+  unsigned spfMaxHold;
+  unsigned areaPrefix;       // kiek pirmųjų adreso bitų nurodo sritį (žr.
+                             // NetworkLayer.h)
+  unsigned spfThreads;       // kiek gijų skaičiuoja maršrutus (žr.
+                             // RouteWorker.h); 0 – kiek branduolių
+  unsigned helloInterval;    // kaimyno gyvumo tikrinimas (žr. LinkLayer.h),
+  unsigned helloMultiplier;  // milisekundėmis ir praleistais intervalais
+
+  Config();
+};
+
+#endif
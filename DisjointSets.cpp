@@ -0,0 +1,33 @@
+#include "DisjointSets.h"
+
+void DisjointSets::reset(unsigned size)
+{
+  mParents.resize(size);
+  for (unsigned i = 0; i < size; i++) mParents[i] = i;
+  mRanks.assign(size, 0);
+}
+
+unsigned DisjointSets::find(unsigned element)
+{
+  while (mParents[element] != element)
+  { // kelio perpus sutrumpinimas
+    mParents[element] = mParents[mParents[element]];
+    element = mParents[element];
+  }
+  return element;
+}
+
+bool DisjointSets::unite(unsigned a, unsigned b)
+{
+  a = find(a);
+  b = find(b);
+  if (a == b) return false;
+  if (mRanks[a] < mRanks[b]) mParents[a] = b;
+  else if (mRanks[a] > mRanks[b]) mParents[b] = a;
+  else
+  {
+    mParents[b] = a;
+    ++mRanks[a];
+  }
+  return true;
+}
@@ -0,0 +1,37 @@
+#ifndef DISJOINTSETS_H
+#define DISJOINTSETS_H
+
+#include <vector>
+#include "types.h"
+
+/**
+ * Nesikertančių aibių miškas (union-find) tankiems numeriams.
+ * Ieškant kelias suspaudžiamas, jungiant žemesnis medis prikabinamas prie
+ * aukštesnio, todėl abi operacijos trunka beveik O(1).
+ */
+class DisjointSets
+{
+  private:
+    vector<unsigned>      mParents;
+    vector<unsigned char> mRanks;
+
+  public:
+    /**
+     * Sukuria size vienelementių aibių {0}, {1}, ..., {size - 1}.
+     */
+    void     reset(unsigned size);
+
+    /**
+     * @return aibės, kuriai priklauso element, atstovas
+     */
+    unsigned find(unsigned element);
+
+    /**
+     * Sujungia a ir b aibes.
+     *
+     * @return false, jei a ir b jau buvo toje pačioje aibėje
+     */
+    bool     unite(unsigned a, unsigned b);
+};
+
+#endif
@@ -1,96 +1,39 @@
 #include "Fragment.h"
 #include <cstring>
 
-Fragment::Fragment(unsigned dataLength, Byte* data, unsigned dataOffset,
-                   unsigned fragmentLength)
+#define CHUNKS(length) (((length) + FRAGMENT_CHUNK - 1) / FRAGMENT_CHUNK)
+#define WORDS(chunks)  (((chunks) + 63) / 64)
+
+size_t Fragment::bufferSize(unsigned dataLength)
 {
-  mDataLength = dataLength;
-  if (0 != dataOffset) mMissing.insert(make_pair(0, dataOffset));
-  if (dataLength != dataOffset + fragmentLength)
-  {
-    mMissing.insert(make_pair(dataOffset + fragmentLength, dataLength));
-  }
-  mData = new Byte[dataLength];
-  memcpy(mData + dataOffset, data, fragmentLength);
+  return WORDS(CHUNKS(dataLength)) * sizeof(unsigned long long) + dataLength;
 }
 
-Fragment::~Fragment()
+void Fragment::reset(Byte* pBuffer, unsigned dataLength)
 {
-  delete[] mData;
+  mDataLength = dataLength;
+  mMissing = CHUNKS(dataLength);
+  mpChunks = (unsigned long long*)pBuffer;
+  mpData = pBuffer + WORDS(mMissing) * sizeof(unsigned long long);
+  memset(mpChunks, 0, WORDS(mMissing) * sizeof(unsigned long long));
 }
 
-void Fragment::add(unsigned dataLength, Byte* data, unsigned dataOffset,
-                   unsigned fragmentLength)
+bool Fragment::add(Byte* data, unsigned dataOffset, unsigned fragmentLength)
 {
-  if (dataLength != mDataLength || dataOffset + fragmentLength > mDataLength)
+  unsigned end = dataOffset + fragmentLength;
+  if (dataOffset % FRAGMENT_CHUNK != 0 || end > mDataLength
+      || (end != mDataLength && fragmentLength % FRAGMENT_CHUNK != 0))
   {
-    recreate(dataLength, data, dataOffset, fragmentLength);
+    return false;
   }
-  else
+  memcpy(mpData + dataOffset, data, fragmentLength);
+  for (unsigned chunk = dataOffset / FRAGMENT_CHUNK; chunk < CHUNKS(end);
+       chunk++)
   {
-    unsigned i = dataOffset;
-    auto it = mMissing.upper_bound(i);
-    if (it != mMissing.begin()) --it;
-    if (it != mMissing.end() && it->second <= i) ++it;
-    for (; it != mMissing.end() && i - dataOffset < fragmentLength;
-         mMissing.erase(it++))
-    {
-      while (i < it->first && i - dataOffset < fragmentLength)
-      {
-        if (data[i - dataOffset] != mData[i])
-        {
-          recreate(dataLength, data, dataOffset, fragmentLength);
-          return;
-        }
-        ++i;
-      }
-      while (i < it->second && i - dataOffset < fragmentLength)
-      {
-        mData[i] = data[i - dataOffset];
-        ++i;
-      }
-      if (i - dataOffset >= fragmentLength)
-      {
-        if (i > it->first && i < it->second)
-        {
-          mMissing.insert(make_pair(i, it->second));
-        }
-      }
-    }
-    while (i - dataOffset < fragmentLength)
-    {
-      if (data[i - dataOffset] != mData[i])
-      {
-        recreate(dataLength, data, dataOffset, fragmentLength);
-        return;
-      }
-      i++;
-    }
+    unsigned long long bit = 1ULL << (chunk % 64);
+    if (mpChunks[chunk / 64] & bit) continue;
+    mpChunks[chunk / 64] |= bit;
+    --mMissing;
   }
-}
-
-void Fragment::recreate(unsigned dataLength, Byte* data, unsigned dataOffset,
-                        unsigned fragmentLength)
-{
-  // Gautas kito turinio to paties ilgio paketas nuo to paties gavėjo tuo pačiu ID
-  if (dataLength > mDataLength)
-  {
-    delete[] mData;
-    mData = new Byte[dataLength];
-  }
-  mDataLength = dataLength;
-  mMissing.clear();
-  mMissing.insert(make_pair(0, dataOffset));
-  mMissing.insert(make_pair(dataOffset + fragmentLength, dataLength));
-  memcpy(mData + dataOffset, data, fragmentLength);
-}
-
-bool Fragment::isComplete()
-{
-  return mMissing.empty();
-}
-
-Byte* Fragment::data()
-{
-  return mData;
+  return true;
 }
@@ -2,28 +2,48 @@
 #define FRAGMENT_H
 
 #include "types.h"
-#include <map>
 
+#define FRAGMENT_CHUNK 8 // fragmento duomenų pradžia (ir ilgis, jei jis ne
+                         // paskutinis) – šio skaičiaus kartotinis
+
+/**
+ * Surenkamas paketas.
+ *
+ * Paketas suskirstytas FRAGMENT_CHUNK baitų dalimis; kurios jau gautos,
+ * žymima bitų masyve. Bitų masyvas ir duomenys laikomi viename išoriniame
+ * buferyje (jo dydis – bufferSize()), kurį išskiria ir atlaisvina kviečiantysis.
+ */
 class Fragment
 {
   private:
-    map<unsigned, unsigned> mMissing;
-    Byte*                   mData;
-    unsigned                mDataLength;
+    unsigned long long* mpChunks;  // gautų dalių bitai
+    Byte*               mpData;
+    unsigned            mDataLength;
+    unsigned            mMissing;  // kiek dalių dar trūksta
 
   public:
-    Fragment(unsigned dataLength, Byte* data, unsigned dataOffset,
-            unsigned fragmentLength);
-    ~Fragment();
+    /**
+     * @return kiek baitų reikia dataLength ilgio paketo surinkimui
+     */
+    static size_t bufferSize(unsigned dataLength);
 
-    void  add(unsigned dataLength, Byte* data, unsigned dataOffset,
-            unsigned fragmentLength);
-    bool  isComplete();
-    Byte* data();
+    /**
+     * Pradeda rinkti naują paketą.
+     *
+     * @param pBuffer bent bufferSize(dataLength) baitų buferis
+     */
+    void          reset(Byte* pBuffer, unsigned dataLength);
 
-  private:
-    void recreate(unsigned dataLength, Byte* data, unsigned dataOffset,
-                  unsigned fragmentLength);
+    /**
+     * Įrašo fragmento duomenis.
+     *
+     * @return false, jei fragmento ribos netinka šiam paketui
+     */
+    bool          add(Byte* data, unsigned dataOffset, unsigned fragmentLength);
+
+    bool          isComplete() const { return mMissing == 0; }
+    Byte*         data() { return mpData; }
+    unsigned      length() const { return mDataLength; }
 };
 
 #endif
@@ -0,0 +1,82 @@
+#include "IndexedHeap.h"
+#include <algorithm>
+
+#define NOT_IN_HEAP 0xffffffffU
+
+bool IndexedHeap::push(unsigned index, unsigned long long key)
+{
+  if (index >= mPositions.size()) mPositions.resize(index + 1, NOT_IN_HEAP);
+  unsigned position = mPositions[index];
+  if (position == NOT_IN_HEAP)
+  {
+    position = mItems.size();
+    mItems.push_back(Item());
+  }
+  else if (mItems[position].key <= key) return false;
+  mItems[position].key = key;
+  mItems[position].index = index;
+  mPositions[index] = position;
+  siftUp(position);
+  return true;
+}
+
+unsigned IndexedHeap::pop(unsigned long long* pKey)
+{
+  Item top = mItems.front();
+  mPositions[top.index] = NOT_IN_HEAP;
+  Item last = mItems.back();
+  mItems.pop_back();
+  if (!mItems.empty())
+  {
+    place(0, last);
+    siftDown(0);
+  }
+  if (pKey != NULL) *pKey = top.key;
+  return top.index;
+}
+
+void IndexedHeap::clear()
+{
+  for (auto& rItem : mItems) mPositions[rItem.index] = NOT_IN_HEAP;
+  mItems.clear();
+}
+
+void IndexedHeap::siftUp(unsigned position)
+{
+  Item item = mItems[position];
+  while (position > 0)
+  {
+    unsigned parent = (position - 1) / HEAP_ARITY;
+    if (mItems[parent].key <= item.key) break;
+    place(position, mItems[parent]);
+    position = parent;
+  }
+  place(position, item);
+}
+
+void IndexedHeap::siftDown(unsigned position)
+{
+  Item item = mItems[position];
+  unsigned size = mItems.size();
+  while (true)
+  {
+    unsigned first = position * HEAP_ARITY + 1;
+    if (first >= size) break;
+    unsigned last = min(first + HEAP_ARITY, size);
+    unsigned best = first;
+    for (unsigned child = first + 1; child < last; child++)
+    {
+      if (mItems[child].key < mItems[best].key) best = child;
+    }
+    if (item.key <= mItems[best].key) break;
+    place(position, mItems[best]);
+    position = best;
+  }
+  place(position, item);
+}
+
+void IndexedHeap::place(unsigned position, const Item& rItem)
+{
+  mItems[position] = rItem;
+  mPositions[rItem.index] = position;
+}
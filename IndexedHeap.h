@@ -0,0 +1,56 @@
+#ifndef INDEXEDHEAP_H
+#define INDEXEDHEAP_H
+
+#include <vector>
+#include "types.h"
+
+#define HEAP_ARITY 4
+
+/**
+ * Indeksuota 4-ainė min-krūva Dijkstros algoritmui.
+ *
+ * Elementai – tankūs indeksai (0, 1, 2, ...), kiekvienam laikoma jo vieta
+ * krūvoje, todėl rakto sumažinimas trunka O(log n) ir eilėje niekada nebūna
+ * pasenusių įrašų. Keturi vaikai telpa į vieną procesoriaus spartinančiosios
+ * atminties eilutę, todėl leidžiantis žemyn mažiau šokinėjama po atmintį nei
+ * dvejetainėje krūvoje.
+ */
+class IndexedHeap
+{
+  private:
+    struct Item
+    {
+      unsigned long long key;
+      unsigned           index;
+    };
+
+  private:
+    vector<Item>     mItems;
+    vector<unsigned> mPositions; // elemento vieta mItems arba NOT_IN_HEAP
+
+  public:
+    bool     empty() const { return mItems.empty(); }
+    unsigned size() const { return mItems.size(); }
+
+    /**
+     * Įdeda elementą arba sumažina jo raktą.
+     *
+     * @return true, jei elementas įdėtas ar raktas sumažintas; false, jei
+     *         elementas jau yra su ne didesniu raktu
+     */
+    bool     push(unsigned index, unsigned long long key);
+
+    /**
+     * Išima mažiausią raktą turintį elementą. Krūva turi būti netuščia.
+     */
+    unsigned pop(unsigned long long* pKey = NULL);
+
+    void     clear();
+
+  private:
+    void     siftUp(unsigned position);
+    void     siftDown(unsigned position);
+    void     place(unsigned position, const Item& rItem);
+};
+
+#endif
@@ -15,6 +15,8 @@ class Layer
     Node* mpNode;
 
   public:
+    virtual ~Layer() { }
+
     /**
      * Iškviečiama, kai baigiasi objekto iškviestas laikmatis.
      */
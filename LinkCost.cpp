@@ -0,0 +1,41 @@
+#include "LinkCost.h"
+
+LinkCost::LinkCost():
+  mAverage(0),
+  mCost(0),
+  mOutliers(0),
+  mEmpty(true)
+{ }
+
+bool LinkCost::add(unsigned sample)
+{
+  unsigned average = mAverage / LINK_COST_WEIGHT;
+  bool outlier = !mEmpty && sample > LINK_COST_OUTLIER * (average + 1);
+  if (outlier && ++mOutliers < LINK_COST_OUTLIERS) return false; // praleidžiama
+  if (mEmpty || outlier)
+  {
+    mAverage = sample * LINK_COST_WEIGHT;
+    mEmpty = false;
+  }
+  else
+  {
+    mAverage += sample;
+    mAverage -= average;
+  }
+  mOutliers = 0;
+  average = (mAverage + LINK_COST_WEIGHT / 2) / LINK_COST_WEIGHT;
+  unsigned s = step(average);
+  unsigned difference = average > mCost ? average - mCost : mCost - average;
+  if (difference < s) return false;
+  unsigned cost = (average + s / 2) / s * s;
+  if (cost == mCost) return false;
+  mCost = cost;
+  return true;
+}
+
+unsigned LinkCost::step(unsigned value)
+{
+  unsigned s = 1;
+  while ((s << 1) <= (value >> LINK_COST_PRECISION)) s <<= 1;
+  return s;
+}
@@ -0,0 +1,50 @@
+#ifndef LINKCOST_H
+#define LINKCOST_H
+
+#define LINK_COST_WEIGHT     8 // naujas matavimas sudaro 1/8 vidurkio
+#define LINK_COST_OUTLIER    4 // kiek kartų už vidurkį didesnis – išskirtis
+#define LINK_COST_OUTLIERS   3 // kelios išskirtys iš eilės – tikras pokytis
+#define LINK_COST_PRECISION  3 // kvantavimo žingsnis – 2^-3 kainos dalis
+
+/**
+ * Kanalo iki vieno kaimyno kainos įvertis pagal ARP atsakymų delsą.
+ *
+ * Matavimai išlyginami eksponentiniu slenkančiuoju vidurkiu (naujam tenka
+ * 1/LINK_COST_WEIGHT svorio). Daugiau nei LINK_COST_OUTLIER kartų už vidurkį
+ * didesni matavimai (pvz., dėl planuoklio vėlavimo) praleidžiami, kol jų
+ * nesusikaupia LINK_COST_OUTLIERS iš eilės – tada vidurkis pradedamas iš naujo
+ * nuo paskutiniojo. Skelbiama kaina – vidurkis, suapvalintas iki žingsnio,
+ * lygaus didžiausiam dvejeto laipsniui, ne didesniam už
+ * 2^-LINK_COST_PRECISION vidurkio (bet ne mažiau 1 ms), ir keičiama tik
+ * vidurkiui nutolus nuo jos bent per žingsnį. Taigi smulkūs svyravimai
+ * nekeičia nei LS paketų, nei persiuntimo lentelės.
+ */
+class LinkCost
+{
+  private:
+    unsigned mAverage;  // vidurkis, padaugintas iš LINK_COST_WEIGHT
+    unsigned mCost;     // skelbiama kaina milisekundėmis
+    unsigned mOutliers; // kiek išskirčių gauta iš eilės
+    bool     mEmpty;    // dar nebuvo matavimų
+
+  public:
+    LinkCost();
+
+    /**
+     * Įrašo naują matavimą.
+     *
+     * @param sample ARP atsakymo delsa milisekundėmis
+     * @return ar pasikeitė skelbiama kaina
+     */
+    bool     add(unsigned sample);
+
+    unsigned cost() const { return mCost; }
+
+  private:
+    /**
+     * @return kvantavimo žingsnis kainai value
+     */
+    static unsigned step(unsigned value);
+};
+
+#endif
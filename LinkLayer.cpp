@@ -1,69 +1,95 @@
 #include "LinkLayer.h"
 #include "Node.h"
 #include <cstdlib>
-#include <cstring>
 
 LinkLayer::LinkLayer(Node* pNode, MacSublayer* pMacSublayer,
                      NetworkLayer* pNetworkLayer):
   Layer(pNode),
   mpMacSublayer(pMacSublayer),
   mpNetworkLayer(pNetworkLayer),
-  mTimersStarted(0),
-  mTimersFinished(0),
   mLastDestination(-1),
-  mIsZombie(false)
-{ }
+  mHelloRetryTimer(0),
+  mHelloTicks(0),
+  mSent(false)
+{
+  mHelloTimer = mpNode->startTimer(this,
+                                   rand() % mpNode->config().helloInterval,
+                                   HELLO_TIMER);
+}
+
+LinkLayer::~LinkLayer()
+{
+  mpNode->cancelTimer(mHelloTimer);
+  mpNode->cancelTimer(mHelloRetryTimer);
+  for (auto& rConnection : mConnections)
+  {
+    mpNode->cancelTimer(rConnection.second.timer);
+  }
+}
 
 void LinkLayer::timer(long long id)
 {
-  ++mTimersFinished;
-  if (mIsZombie)
+  if (id == HELLO_TIMER)
   {
-    if (mTimersFinished == mTimersStarted) delete this;
+    hello();
     return;
   }
-  auto it = mTimerToConnection.find(id);
-  auto addressAndConnectionPtr = it->second;
-  mTimerToConnection.erase(it);
-  if (addressAndConnectionPtr.second->timer == id)
+  if (id == HELLO_RETRY_TIMER)
   {
-    if (addressAndConnectionPtr.second->timeouts < MAX_RETRIES)
-    {
-      toMacSublayer(addressAndConnectionPtr.first,
-                    addressAndConnectionPtr.second);
-    }
-    else
-    {
-      info("Ryšys su %llx nutrauktas.\n", addressAndConnectionPtr.first);
-      *(addressAndConnectionPtr.second) = Connection();
-    }
+    mHelloRetryTimer = 0;
+    sendHello();
+    return;
+  }
+  auto it = mConnections.find(id);
+  if (it == mConnections.end())
+  {
+    info("Klaida: nerastas laikmačio %llx ryšys.\n", id);
+    return;
+  }
+  it->second.timer = 0;
+  if (it->second.timeouts < MAX_RETRIES) toMacSublayer(id, &it->second);
+  else
+  {
+    info("Ryšys su %llx nutrauktas.\n", id);
+    ++it->second.statistics.retriesExhausted;
+    bool blocked = it->second.blocked || it->second.controlFull;
+    it->second.reset();
+    if (blocked) mpNetworkLayer->linkReady(this, id);
   }
 }
 
-void LinkLayer::fromMacSublayer(MacAddress source, Frame& rFrame)
+void LinkLayer::fromMacSublayer(MacAddress source, PacketBuffer& rFrame)
 {
-  if (rFrame.length == 0)
+  FrameLength frameLength = rFrame.length(); // kadrą gali paimti tinklo lygis
+  if (frameLength == 0)
   {
     info("Gautas tuščias kadras.\n");
     return;
   }
-  ControlByte controlByte = rFrame.data[0];
+  ControlByte controlByte = rFrame.data()[0];
   info("Gautas kadras nuo %llx (tipas %hhu, Seq %hhu, Ack %hhu)\n", source,
         controlByte.type, controlByte.seq, controlByte.ack);
+  Connection& rConnection = mConnections[source];
+  rConnection.heard = mHelloTicks;
+  rConnection.alive = true;
+  if (controlByte.type == 3) return; // gyvumo kadras
   if (controlByte.type == 2)
   {
     info("Gautas visiems skirtas kadras nuo %llx.\n", source);
-    mpNetworkLayer->fromLinkLayer(this, source, rFrame.data + 1,
-                                    rFrame.length - 1);
+    toNetworkLayer(source, rFrame);
     return;
   }
-  Connection& rConnection = mConnections[source];
-  if (controlByte == 0 && rFrame.length == 1)
+  ++rConnection.statistics.framesReceived;
+  if (controlByte == 0 && frameLength == 1)
   { // inicializuoja susijungimą
     if (rConnection.controlByte.type != 0)
     {
       info("%llx nori prisijungti iš naujo.\n", source);
-      rConnection.framePtrQueue.push_front(new Frame(1));
+      if (!rConnection.framePtrQueue.empty())
+      { // siųstas kadras lieka prieš vėlesnius valdymo kadrus
+        ++rConnection.controlFrames;
+      }
+      rConnection.framePtrQueue.push_front(new PacketBuffer(1, 0));
       mLastDestination = -1;
     }
     else info("%llx nori prisijungti.\n", source);
@@ -72,12 +98,12 @@ void LinkLayer::fromMacSublayer(MacAddress source, Frame& rFrame)
   }
   else if (rConnection.controlByte == 0)
   {
-    if (controlByte == 1 && rFrame.length == 1)
+    if (controlByte == 1 && frameLength == 1)
     {
       info("%llx patvirtino prisijungimą.\n", source);
       rConnection.controlByte.type = 1;
       rConnection.controlByte.ack++;
-      gotAck(rConnection);
+      gotAck(source, rConnection);
       toMacSublayer(source, &rConnection);
     }
     else info("%llx nepatvirtino prisijungimo, bet kažką siuntė.\n", source);
@@ -85,7 +111,7 @@ void LinkLayer::fromMacSublayer(MacAddress source, Frame& rFrame)
   else if (controlByte.type != 1)
   {
     info("%llx atsiuntė netinkamo tipo kadrą (tipas %hhu, ilgis %d).\n",
-         source, controlByte.type, rFrame.length);
+         source, controlByte.type, frameLength);
   }
   else if (controlByte.ack == rConnection.controlByte.seq)
   { // nepatvirtino
@@ -97,20 +123,23 @@ void LinkLayer::fromMacSublayer(MacAddress source, Frame& rFrame)
         info("Naujas kadras nuo %llx.\n", source);
       }
       else info("%llx nepatvirtino, tačiau atsiuntė naują kadrą.\n", source);
-      mpNetworkLayer->fromLinkLayer(this, source, rFrame.data + 1,
-                                    rFrame.length - 1);
+      toNetworkLayer(source, rFrame);
     }
-    else info("%llx nepatvirtino ir atsiuntė seną kadrą.\n", source);
-    if (rFrame.length > 1) needsAck(source, &rConnection);
+    else
+    {
+      info("%llx nepatvirtino ir atsiuntė seną kadrą.\n", source);
+      ++rConnection.statistics.duplicates;
+    }
+    if (frameLength > 1) needsAck(source, &rConnection);
     else info("%llx atsiuntė tuščią kadrą, nors taip neturėtų būti.\n", source);
   }
   else if (--(controlByte.ack) == rConnection.controlByte.seq)
   { // patvirtino
     if (rConnection.controlByte == 1) rConnection.controlByte.type = 1;
-    gotAck(rConnection);
+    gotAck(source, rConnection);
     if (controlByte.seq == rConnection.controlByte.ack)
     { // naujas kadras
-      if (rFrame.length > 1)
+      if (frameLength > 1)
       {
         info("%llx patvirtino ir atsiuntė naują kadrą.\n", source);
         rConnection.controlByte.ack++;
@@ -120,12 +149,12 @@ void LinkLayer::fromMacSublayer(MacAddress source, Frame& rFrame)
       {
         info("%llx nurodė naują Seq, tačiau paketo neatsiuntė.\n", source);
       }
-      mpNetworkLayer->fromLinkLayer(this, source, rFrame.data + 1,
-                                    rFrame.length - 1);
+      toNetworkLayer(source, rFrame);
     }
-    else if (rFrame.length > 1)
+    else if (frameLength > 1)
     {
       info("%llx pridėjo paketą, nors pagal Seq jo neturėjo būti.\n", source);
+      ++rConnection.statistics.duplicates;
     }
     else
     {
@@ -145,12 +174,12 @@ void LinkLayer::fromMacSublayer(MacAddress source, Frame& rFrame)
             source, controlByte.type, controlByte.seq, ++(controlByte.ack));
 }
 
-bool LinkLayer::fromNetworkLayer(MacAddress destination, Byte* packet,
-                                 FrameLength packetLength)
+bool LinkLayer::fromNetworkLayer(MacAddress destination, PacketBuffer& rPacket,
+                                 bool isControl)
 {
-  info("Tinklo lygis perdavė %hu dydžio paketą, adresuotą %llx.\n",
-       packetLength, destination);
-  if (packetLength > MAX_DATA_LENGTH - 1)
+  info("Tinklo lygis perdavė %u dydžio paketą, adresuotą %llx.\n",
+       rPacket.length(), destination);
+  if (rPacket.length() > MAX_DATA_LENGTH - 1)
   {
     info("Paketas per didelis.\n");
     return false;
@@ -162,13 +191,35 @@ bool LinkLayer::fromNetworkLayer(MacAddress destination, Byte* packet,
     delete rConnection.framePtrQueue.back();
     rConnection.framePtrQueue.pop_back();
   }
-  if (rConnection.framePtrQueue.size() >= MAX_FRAME_QUEUE_SIZE)
+  if (isControl)
+  {
+    if (rConnection.controlFrames >= mpNode->config().controlQueueSize)
+    {
+      info("Valdymo kadrų siuntimo į %llx eilė pilna.\n", destination);
+      rConnection.controlFull = true;
+      ++rConnection.statistics.dropped;
+      return false;
+    }
+  }
+  else if (rConnection.framePtrQueue.size() - rConnection.controlFrames
+           >= mpNode->config().frameQueueSize)
   {
     info("Siuntimo į %llx eilė pilna.\n", destination);
+    rConnection.blocked = true;
+    ++rConnection.statistics.dropped;
     return false;
   }
-  rConnection.framePtrQueue.push_back(new Frame(packetLength + 1));
-  memcpy(rConnection.framePtrQueue.back()->data + 1, packet, packetLength);
+  PacketBuffer* pFrame = new PacketBuffer();
+  pFrame->swap(rPacket);
+  pFrame->push(1);
+  if (isControl && !rConnection.framePtrQueue.empty())
+  { // aplenkia duomenis, bet ne jau siunčiamą kadrą
+    rConnection.framePtrQueue.insert(rConnection.framePtrQueue.begin() + 1
+                                     + rConnection.controlFrames, pFrame);
+    ++rConnection.controlFrames;
+  }
+  else rConnection.framePtrQueue.push_back(pFrame);
+  rConnection.statistics.queue.add(rConnection.framePtrQueue.size());
   if (rConnection.timeouts == 0)
   {
     toMacSublayer(destination, &rConnection);
@@ -184,12 +235,9 @@ void LinkLayer::startTimer(MacAddress destination, Connection* pConnection,
     info("Laikmatis nepaleidžiamas, kadangi siunčiama visiems.\n");
     return;
   }
-  mTimerToConnection.insert(make_pair(++mTimersStarted,
-                                      make_pair(destination, pConnection)));
-  pConnection->timer = mTimersStarted;
   if (ack)
   {
-    mpNode->startTimer(this, ACK_TIMEOUT, mTimersStarted);
+    setTimer(destination, pConnection, ACK_TIMEOUT);
     info("Už nedaugiau nei %d ms išsiųs patvirtinimą.\n", ACK_TIMEOUT);
     return;
   }
@@ -209,31 +257,41 @@ void LinkLayer::startTimer(MacAddress destination, Connection* pConnection,
   ++(pConnection->timeouts);
   info("Patvirtinimo lauks %d ms (%d bandymas).\n", pConnection->lastDuration,
        pConnection->timeouts);
-  mpNode->startTimer(this, pConnection->lastDuration, mTimersStarted);
+  setTimer(destination, pConnection, pConnection->lastDuration);
 }
 
-void LinkLayer::selfDestruct()
+void LinkLayer::setTimer(MacAddress destination, Connection* pConnection,
+                         int milliseconds)
 {
-  if (mTimersStarted != mTimersFinished) mIsZombie = true;
-  else delete this;
+  if (!mpNode->restartTimer(pConnection->timer, milliseconds))
+  {
+    pConnection->timer = mpNode->startTimer(this, milliseconds, destination);
+  }
 }
 
 void LinkLayer::toMacSublayer(MacAddress destination, Connection* pConnection)
 {
   if (pConnection->framePtrQueue.empty()) // reikia siųsti tik Ack
   {
-    Frame ackFrame(1);
+    PacketBuffer ackFrame(1, 0);
     ControlByte controlByte = pConnection->controlByte;
     controlByte.seq--;
-    ackFrame.data[0] = controlByte;
+    ackFrame.data()[0] = controlByte;
     info("Siunčia Ack į %llx (tipas %hhu, Seq %hhu, Ack %hhu)\n", destination,
          controlByte.type, controlByte.seq, controlByte.ack);
     mpMacSublayer->fromLinkLayer(destination, &ackFrame);
+    ++pConnection->statistics.acksSent;
   }
   else
   {
     startTimer(destination, pConnection); // galėtų būti vėliau, bet kad
                                           // neištrintų atjungus laidą
+    if (pConnection->timeouts > 1) ++pConnection->statistics.retransmissions;
+    else
+    {
+      ++pConnection->statistics.framesSent;
+      clock_gettime(CLOCK_MONOTONIC, &pConnection->sentTime);
+    }
     if (mLastDestination == destination
        && mLastControlByte == pConnection->controlByte)
     {
@@ -244,20 +302,63 @@ void LinkLayer::toMacSublayer(MacAddress destination, Connection* pConnection)
     else
     {
       mLastControlByte = pConnection->controlByte;
-      Frame* pFrame = pConnection->framePtrQueue.front();
-      if (pFrame->length > 0) pFrame->data[0] = mLastControlByte;
+      PacketBuffer* pFrame = pConnection->framePtrQueue.front();
+      if (pFrame->length() > 0) pFrame->data()[0] = mLastControlByte;
       info("Siunčia į %llx (tipas %hhu, Seq %hhu, Ack %hhu)\n", destination,
            mLastControlByte.type, mLastControlByte.seq, mLastControlByte.ack);
-      mpMacSublayer->fromLinkLayer(destination, pFrame);
+      bool sent = mpMacSublayer->fromLinkLayer(destination, pFrame);
       if (destination == BROADCAST_MAC)
-      {
-        delete pConnection->framePtrQueue.front();
-        pConnection->framePtrQueue.pop_front();
+      { // jį gauna visi laido kaimynai, todėl atstoja gyvumo kadrą
+        mSent |= sent;
+        popFront(destination, *pConnection);
       }
     }
   }
 }
 
+void LinkLayer::hello()
+{
+  const Config& rConfig = mpNode->config();
+  unsigned interval = rConfig.helloInterval;
+  interval -= rand() % (interval * HELLO_JITTER / 100 + 1);
+  mHelloTimer = mpNode->startTimer(this, interval, HELLO_TIMER);
+  ++mHelloTicks;
+  if (mSent) mSent = false;
+  else if (mHelloRetryTimer == 0) sendHello();
+  vector<MacAddress> lost;
+  for (auto& rConnection : mConnections)
+  {
+    Connection& rLost = rConnection.second;
+    if (!rLost.alive || mHelloTicks - rLost.heard <= rConfig.helloMultiplier)
+    {
+      continue;
+    }
+    info("Kaimynas %llx nebeatsako, ryšys nutrauktas.\n", rConnection.first);
+    ++rLost.statistics.livenessLost;
+    rLost.alive = false;
+    mpNode->cancelTimer(rLost.timer);
+    rLost.reset();
+    lost.push_back(rConnection.first);
+  }
+  // tinklo lygis gali siųsti ir taip keisti mConnections
+  for (auto neighbour : lost) mpNetworkLayer->neighbourLost(this, neighbour);
+}
+
+void LinkLayer::sendHello()
+{
+  PacketBuffer helloFrame(1, 0);
+  ControlByte controlByte;
+  controlByte.type = 3;
+  helloFrame.data()[0] = controlByte;
+  mLastDestination = -1; // MAC polygio buferyje bus kitas kadras
+  if (!mpMacSublayer->fromLinkLayer(BROADCAST_MAC, &helloFrame))
+  { // laidas užimtas – bandoma vėl jam atsilaisvinus
+    mHelloRetryTimer = mpNode->startTimer(this, SIGNAL_TIMEOUT
+                                                + rand() % SIGNAL_TIMEOUT,
+                                          HELLO_RETRY_TIMER);
+  }
+}
+
 void LinkLayer::needsAck(MacAddress destination, Connection* pConnection)
 {
   if (pConnection->framePtrQueue.empty())
@@ -272,7 +373,7 @@ void LinkLayer::needsAck(MacAddress destination, Connection* pConnection)
   }
 }
 
-void LinkLayer::gotAck(Connection& rConnection)
+void LinkLayer::gotAck(MacAddress source, Connection& rConnection)
 {
   if (rConnection.framePtrQueue.empty())
   {
@@ -280,8 +381,59 @@ void LinkLayer::gotAck(Connection& rConnection)
     return;
   }
   rConnection.controlByte.seq++;
-  delete rConnection.framePtrQueue.front();
-  rConnection.framePtrQueue.pop_front();
+  if (rConnection.timeouts == 1)
+  {
+    timespec current;
+    clock_gettime(CLOCK_MONOTONIC, &current);
+    current = current - rConnection.sentTime;
+    rConnection.statistics.rtt.add(current.tv_sec * 1000
+                                   + current.tv_nsec / MILLION);
+  }
+  popFront(source, rConnection); // timeouts dar nenulinis, todėl čia tinklo
+                                 // lygio įdėti kadrai bus išsiųsti vėliau
+  mpNode->cancelTimer(rConnection.timer);
   rConnection.timer = 0;
   rConnection.timeouts = 0;
 }
+
+void LinkLayer::toNetworkLayer(MacAddress source, PacketBuffer& rFrame)
+{
+  rFrame.pull(1);
+  mpNetworkLayer->fromLinkLayer(this, source, rFrame);
+}
+
+void LinkLayer::popFront(MacAddress destination, Connection& rConnection)
+{
+  delete rConnection.framePtrQueue.front();
+  rConnection.framePtrQueue.pop_front();
+  if (rConnection.controlFrames > 0) --rConnection.controlFrames;
+  bool ready = false;
+  if (rConnection.blocked
+      && rConnection.framePtrQueue.size() - rConnection.controlFrames
+         < mpNode->config().frameQueueSize)
+  {
+    rConnection.blocked = false;
+    ready = true;
+  }
+  if (rConnection.controlFull
+      && rConnection.controlFrames < mpNode->config().controlQueueSize)
+  {
+    rConnection.controlFull = false;
+    ready = true;
+  }
+  if (ready) mpNetworkLayer->linkReady(this, destination);
+}
+
+const LinkStatistics* LinkLayer::statistics(MacAddress neighbour) const
+{
+  auto it = mConnections.find(neighbour);
+  return it == mConnections.end() ? NULL : &it->second.statistics;
+}
+
+void LinkLayer::printStatistics(FILE* pFile) const
+{
+  for (auto& rConnection : mConnections)
+  {
+    rConnection.second.statistics.print(pFile, rConnection.first);
+  }
+}
@@ -1,7 +1,9 @@
 #ifndef LINKLAYER_H
 #define LINKLAYER_H
 #include "Layer.h"
-#include "Frame.h"
+#include "PacketBuffer.h"
+#include "LinkStatistics.h"
+#include <ctime>
 #include <unordered_map>
 #include <deque>
 
@@ -10,7 +12,13 @@
 #define MAX_FRAME_TIMEOUT   10000LL
 #define FRAME_TIMEOUT_DECR     50LL
 #define MAX_FRAME_QUEUE_SIZE   10
+#define MAX_CONTROL_QUEUE_SIZE 10
 #define MAX_RETRIES            10
+#define HELLO_INTERVAL       5000 // žr. „Kaimyno gyvumas“
+#define HELLO_MULTIPLIER        4
+#define HELLO_JITTER           25 // procentais
+#define HELLO_TIMER   (1LL << 48) // gyvumo laikmačių id (ne MAC adresai)
+#define HELLO_RETRY_TIMER (HELLO_TIMER + 1)
 
 class Node;
 class MacSublayer;
@@ -42,6 +50,39 @@ class NetworkLayer;
  * Po ryšio užmezgimo pirmo siunčiamo paketo Seq laukas lygus 1, vėlesnių didėja
  * po vieną. Kai Seq viršija MAX_SEQ, jis tampa 0.
  *
+ * Eilės.
+ * Kiekvienam adresatui laikoma viena kadrų eilė, kurios priekyje – siunčiamas
+ * ir dar nepatvirtintas kadras. Tinklo valdymo kadrai (ARP, LS) įterpiami iškart
+ * už jo ir anksčiau įterptų valdymo kadrų, todėl aplenkia visus duomenis. Jiems
+ * skirta atskira talpa (numatyta MAX_CONTROL_QUEUE_SIZE), o duomenims – kita
+ * (numatyta MAX_FRAME_QUEUE_SIZE), taigi pilna duomenų eilė valdymo kadrų
+ * neatmeta. Jei duomenų arba valdymo kadras buvo atmestas dėl pilnos eilės,
+ * atsiradus vietai toje eilėje apie tai pranešama tinklo lygiui
+ * (NetworkLayer::linkReady()).
+ *
+ * Kaimyno gyvumas.
+ * Kas Config::helloInterval (numatyta HELLO_INTERVAL) milisekundžių, iki
+ * HELLO_JITTER procentų sutrumpinus atsitiktinai (kad abiejų laido galų kadrai
+ * nuolat nesusidurtų), laidu visiems siunčiamas vieno baito gyvumo kadras,
+ * kurio tipas 3. Jei per tą intervalą pavyko išsiųsti kitą kadrą visiems, jis
+ * praleidžiamas (kitiems kaimynams adresuotus kadrus MAC polygis išmeta, todėl
+ * jie gyvumo kadro neatstoja), o jei laidas užimtas, bandoma vėl po
+ * atsitiktinio laiko iš [SIGNAL_TIMEOUT; 2 * SIGNAL_TIMEOUT) ms. Bet koks iš
+ * kaimyno gautas kadras rodo, kad jis gyvas. Jei iš jau girdėto kaimyno per
+ * Config::helloMultiplier (numatyta HELLO_MULTIPLIER) intervalų negauta nieko,
+ * ryšys su juo nutraukiamas (eilė išmetama) ir tinklo lygiui pranešama, kad
+ * kaimyno nebėra (NetworkLayer::neighbourLost()). Laikas matuojamas gyvumo
+ * laikmačio tiksais, todėl gaunant kadrus laikrodis neskaitomas. Intervalą
+ * galima mažinti iki dešimčių milisekundžių, tačiau šiame laide prieš kiekvieną
+ * bitą iki milisekundės tikrinama, ar jis laisvas, todėl net trumpiausias
+ * kadras siunčiamas apie sekundę, ir numatytasis intervalas pasirinktas toks,
+ * kad gyvumo kadrai neužimtų laido.
+ *
+ * Statistika.
+ * Kiekvienam kaimynui skaičiuojami išsiųsti, gauti, pakartoti ir pasikartoję
+ * kadrai, nutraukti ryšiai, eilės ilgis ir RTT (tik nekartotų kadrų – kartotų
+ * Ack negalima susieti su konkrečiu siuntimu), žr. LinkStatistics.h.
+ *
  * Siunčiant visiems (į BROADCAST_MAC) ryšys neužmezgamas, paketų gavimas
  * nepatvirtinamas, tarnybinio baito reikšmė neapibrėžta ir nenaudojama.
  */
@@ -49,11 +90,12 @@ class NetworkLayer;
 class LinkLayer: public Layer
 {
   private:
-    typedef deque<Frame*>   FramePtrQueue;
+    typedef deque<PacketBuffer*> FramePtrQueue;
 
     struct ControlByte
     {
-      unsigned char type : 2; // 0 – užmezgimas, 1 – vienam, 2 – visiems
+      unsigned char type : 2; // 0 – užmezgimas, 1 – vienam, 2 – visiems,
+                              // 3 – gyvumo kadras
       unsigned char seq  : 3;
       unsigned char ack  : 3;
 
@@ -86,25 +128,57 @@ class LinkLayer: public Layer
      */
     struct Connection
     {
-      ControlByte   controlByte;
-      FramePtrQueue framePtrQueue; // nepristatyti kadrai
-      int           timer;         // identifikatorius laikmačio, į kurį reikėtų
-                                   // reaguoti pakartotinai išsiunčiant kadrą
-      int           timeouts;      // kiek kartų eilės priekyje esantis kadras
-                                   // buvo išsiųstas
-      int           lastDuration;  // paskiausia laukimo trukmė
-      
+      ControlByte    controlByte;
+      FramePtrQueue  framePtrQueue; // nepristatyti kadrai
+      unsigned       controlFrames; // kiek valdymo kadrų eina iškart po
+                                    // eilės priekio
+      bool           blocked;       // ar atmestas duomenų kadras, nes eilė
+                                    // buvo pilna
+      bool           controlFull;   // ar atmestas valdymo kadras, nes
+                                    // valdymo eilė buvo pilna
+      TimerHandle    timer;         // laikmatis, kuriam pasibaigus reikia
+                                    // pakartotinai išsiųsti kadrą arba Ack
+      int            timeouts;      // kiek kartų eilės priekyje esantis kadras
+                                    // buvo išsiųstas
+      int            lastDuration;  // paskiausia laukimo trukmė
+      timespec       sentTime;      // kada pirmą kartą išsiųstas eilės priekis
+      LinkStatistics statistics;    // nenulinama reset()
+      unsigned       heard;         // gyvumo tiksas, kai paskutinį kartą kas
+                                    // nors gauta (nenulinama reset())
+      bool           alive;         // ar kaimynas girdėtas ir dar neprapuolė
+
       Connection():
-        controlByte(0),
         timer(0),
-        timeouts(0),
-        lastDuration(MIN_FRAME_TIMEOUT)
+        heard(0),
+        alive(false)
       {
-        framePtrQueue.push_back(new Frame(1)); // VALGRIND
-        framePtrQueue.back()->data[0] = ControlByte();
+        reset();
       }
 
       ~Connection()
+      {
+        clear();
+      }
+
+      /**
+       * Grąžina į pradinę (ryšys neužmegztas) būseną.
+       * Laikmatį prieš tai turi atšaukti kanalinis lygis.
+       */
+      void reset()
+      {
+        clear();
+        controlByte = 0;
+        controlFrames = 0;
+        blocked = false;
+        controlFull = false;
+        timer = 0;
+        timeouts = 0;
+        lastDuration = MIN_FRAME_TIMEOUT;
+        framePtrQueue.push_back(new PacketBuffer(1, 0)); // VALGRIND
+        framePtrQueue.back()->data()[0] = ControlByte();
+      }
+
+      void clear()
       {
         while (!framePtrQueue.empty())
         {
@@ -115,24 +189,46 @@ class LinkLayer: public Layer
     };
 
   private:
-    MacSublayer*                                             mpMacSublayer;
-    NetworkLayer*                                            mpNetworkLayer;
-    unordered_map<MacAddress, Connection>                    mConnections;
-    unsigned long long                                       mTimersStarted;
-    unsigned long long                                       mTimersFinished;
-    unordered_map<long long, pair<MacAddress, Connection*> > mTimerToConnection;
-    MacAddress                                               mLastDestination;
-    ControlByte                                              mLastControlByte;
-    bool                                                     mIsZombie : 1;
+    MacSublayer*                          mpMacSublayer;
+    NetworkLayer*                         mpNetworkLayer;
+    unordered_map<MacAddress, Connection> mConnections; // laikmačio id – raktas
+    MacAddress                            mLastDestination;
+    ControlByte                           mLastControlByte;
+    TimerHandle                           mHelloTimer;
+    TimerHandle                           mHelloRetryTimer;
+    unsigned                              mHelloTicks;
+    bool                                  mSent; // ar per šį gyvumo intervalą
+                                                 // siųsta kitų kadrų visiems
 
   public:
     LinkLayer(Node* pNode, MacSublayer* pMacSublayer,
               NetworkLayer* pNetworkLayer);
+    ~LinkLayer();
     void timer(long long id); // žr. Layer.h
-    bool fromNetworkLayer(MacAddress destination, Byte* packet,
-                          FrameLength packetLength);
-    void fromMacSublayer(MacAddress source, Frame& rFrame);
-    void selfDestruct();
+
+    /**
+     * Įdeda paketą į siuntimo eilę. Priimto paketo buferis paimamas (prieš
+     * jį įrašomas tarnybinis baitas), o rPacket lieka tuščias.
+     *
+     * @param destination  gavėjo MAC adresas
+     * @param rPacket      paketas
+     * @param isControl    ar tai tinklo valdymo paketas (siunčiamas pirmiau)
+     * @return true, jei paketas priimtas; false, jei per didelis arba eilė
+     *         pilna (tada rPacket nepakeičiamas)
+     */
+    bool fromNetworkLayer(MacAddress destination, PacketBuffer& rPacket,
+                          bool isControl = false);
+    void fromMacSublayer(MacAddress source, PacketBuffer& rFrame);
+
+    /**
+     * @return ryšio su kaimynu statistika arba NULL, jei su juo nebendrauta
+     */
+    const LinkStatistics* statistics(MacAddress neighbour) const;
+
+    /**
+     * Išveda visų šio laido kaimynų statistiką.
+     */
+    void printStatistics(FILE* pFile) const;
 
   protected:
     const char* layerName()
@@ -140,10 +236,34 @@ class LinkLayer: public Layer
 
   private:
     void toMacSublayer(MacAddress destination, Connection* pConnection);
+
+    /**
+     * Išsiunčia gyvumo kadrą ir nutraukia ryšius su prapuolusiais kaimynais.
+     */
+    void hello();
+
+    /**
+     * Siunčia gyvumo kadrą; jei laidas užimtas, bandys vėl.
+     */
+    void sendHello();
+
     void startTimer(MacAddress destination, Connection* pConnection,
                     bool ack = false);
+    void setTimer(MacAddress destination, Connection* pConnection,
+                  int milliseconds);
     void needsAck(MacAddress destination, Connection* pConnection);
-    void gotAck(Connection& rConnection);
+    void gotAck(MacAddress source, Connection& rConnection);
+
+    /**
+     * Nuima tarnybinį baitą ir perduoda kadrą tinklo lygiui.
+     */
+    void toNetworkLayer(MacAddress source, PacketBuffer& rFrame);
+
+    /**
+     * Išmeta eilės priekyje esantį kadrą ir, jei eilė buvo pilna, praneša
+     * tinklo lygiui, kad atsirado vietos.
+     */
+    void popFront(MacAddress destination, Connection& rConnection);
 };
 
 #endif
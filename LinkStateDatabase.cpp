@@ -0,0 +1,205 @@
+#include "LinkStateDatabase.h"
+#include <algorithm>
+
+EdgeStore::EdgeStore():
+  mGarbage(0)
+{ }
+
+void EdgeStore::assign(unsigned node, const Edge* first, const Edge* last)
+{
+  unsigned count = last - first;
+  reserve(node, count);
+  Range& rRange = mRanges[node];
+  copy(first, last, mEdges.begin() + rRange.start);
+  rRange.count = count;
+}
+
+void EdgeStore::add(unsigned node, const Edge& rEdge)
+{
+  unsigned count = this->count(node);
+  reserve(node, count + 1);
+  Range& rRange = mRanges[node];
+  mEdges[rRange.start + count] = rEdge;
+  rRange.count = count + 1;
+}
+
+void EdgeStore::remove(unsigned node, unsigned target)
+{
+  if (node >= mRanges.size()) return;
+  Range& rRange = mRanges[node];
+  for (unsigned i = rRange.start; i < rRange.start + rRange.count; i++)
+  {
+    if (mEdges[i].node == target)
+    {
+      mEdges[i] = mEdges[rRange.start + rRange.count - 1];
+      --rRange.count;
+      return;
+    }
+  }
+}
+
+void EdgeStore::clear(unsigned node)
+{
+  if (node >= mRanges.size()) return;
+  mGarbage += mRanges[node].capacity;
+  mRanges[node].start = 0;
+  mRanges[node].count = 0;
+  mRanges[node].capacity = 0;
+}
+
+size_t EdgeStore::memoryUsage() const
+{
+  return mRanges.capacity() * sizeof(Range) + mEdges.capacity() * sizeof(Edge);
+}
+
+void EdgeStore::reserve(unsigned node, unsigned capacity)
+{
+  if (node >= mRanges.size())
+  {
+    Range empty = { 0, 0, 0 };
+    mRanges.resize(node + 1, empty);
+  }
+  Range& rRange = mRanges[node];
+  if (capacity <= rRange.capacity) return;
+  unsigned newCapacity = max(capacity, rRange.capacity * 2);
+  if (rRange.start + rRange.capacity == mEdges.size())
+  { // paskutinė atkarpa – užtenka padidinti masyvą
+    mEdges.resize(rRange.start + newCapacity);
+  }
+  else
+  {
+    unsigned start = mEdges.size();
+    mEdges.resize(start + newCapacity);
+    copy(mEdges.begin() + rRange.start,
+         mEdges.begin() + rRange.start + rRange.count, mEdges.begin() + start);
+    mGarbage += rRange.capacity;
+    rRange.start = start;
+  }
+  rRange.capacity = newCapacity;
+  if (mGarbage > mEdges.size() / 2) compact();
+}
+
+void EdgeStore::compact()
+{
+  vector<Edge> edges;
+  edges.reserve(mEdges.size() - mGarbage);
+  for (auto& rRange : mRanges)
+  {
+    unsigned start = edges.size();
+    edges.insert(edges.end(), mEdges.begin() + rRange.start,
+                 mEdges.begin() + rRange.start + rRange.capacity);
+    rRange.start = start;
+  }
+  mEdges.swap(edges);
+  mGarbage = 0;
+}
+
+LinkStateDatabase::LinkStateDatabase():
+  mStates(0)
+{ }
+
+unsigned LinkStateDatabase::find(IpAddress address) const
+{
+  auto it = mIds.find(address);
+  return it == mIds.end() ? NO_NODE : it->second;
+}
+
+unsigned LinkStateDatabase::intern(IpAddress address)
+{
+  auto inserted = mIds.insert(make_pair(address, 0U));
+  if (!inserted.second) return inserted.first->second;
+  unsigned node;
+  if (mFree.empty())
+  {
+    node = mAddresses.size();
+    mAddresses.push_back(address);
+    mNodes.push_back(NodeInfo());
+  }
+  else
+  {
+    node = mFree.back();
+    mFree.pop_back();
+    mAddresses[node] = address;
+  }
+  NodeInfo& rInfo = mNodes[node];
+  rInfo.hasState = false;
+  rInfo.sequence = 0;
+  rInfo.baseSequence = 0;
+  rInfo.timeout.tv_sec = 0;
+  rInfo.timeout.tv_nsec = 0;
+  rInfo.lastId = 0;
+  inserted.first->second = node;
+  return node;
+}
+
+void LinkStateDatabase::bind(unsigned node, IpAddress address)
+{
+  if (node < mAddresses.size())
+  {
+    if (mAddresses[node] == address && find(address) == node) return;
+    auto it = mIds.find(mAddresses[node]);
+    if (it != mIds.end() && it->second == node) mIds.erase(it);
+  }
+  else
+  {
+    mAddresses.resize(node + 1);
+    NodeInfo empty = { false, 0, 0, { 0, 0 }, 0 };
+    mNodes.resize(node + 1, empty);
+  }
+  mAddresses[node] = address;
+  mIds[address] = node;
+}
+
+bool LinkStateDatabase::release(unsigned node)
+{
+  if (mNodes[node].hasState || mIn.count(node) > 0) return false;
+  auto it = mIds.find(mAddresses[node]);
+  if (it == mIds.end() || it->second != node) return false; // jau atlaisvintas
+  mIds.erase(it);
+  mOut.clear(node);
+  mIn.clear(node);
+  mFree.push_back(node);
+  return true;
+}
+
+void LinkStateDatabase::setEdges(unsigned node, EdgeList& rEdges)
+{
+  EdgeList old(mOut.begin(node), mOut.end(node));
+  for (auto& rEdge : old) mIn.remove(rEdge.node, node);
+  mOut.assign(node, rEdges.empty() ? NULL : &rEdges[0],
+              rEdges.empty() ? NULL : &rEdges[0] + rEdges.size());
+  for (auto& rEdge : rEdges)
+  {
+    Edge reverse = { node, rEdge.weight, rEdge.mtu };
+    mIn.add(rEdge.node, reverse);
+  }
+  rEdges.swap(old);
+  if (!mNodes[node].hasState)
+  {
+    mNodes[node].hasState = true;
+    ++mStates;
+  }
+}
+
+void LinkStateDatabase::removeState(unsigned node, EdgeList& rOld)
+{
+  rOld.assign(mOut.begin(node), mOut.end(node));
+  for (auto& rEdge : rOld) mIn.remove(rEdge.node, node);
+  mOut.clear(node);
+  if (mNodes[node].hasState)
+  {
+    mNodes[node].hasState = false;
+    --mStates;
+  }
+  mNodes[node].sequence = 0;
+}
+
+size_t LinkStateDatabase::memoryUsage() const
+{
+  return mIds.size() * (sizeof(pair<IpAddress, unsigned>) + 2 * sizeof(void*))
+         + mIds.bucket_count() * sizeof(void*)
+         + mAddresses.capacity() * sizeof(IpAddress)
+         + mNodes.capacity() * sizeof(NodeInfo)
+         + mFree.capacity() * sizeof(unsigned)
+         + mOut.memoryUsage() + mIn.memoryUsage();
+}
@@ -0,0 +1,176 @@
+#ifndef LINKSTATEDATABASE_H
+#define LINKSTATEDATABASE_H
+
+#include <vector>
+#include <unordered_map>
+#include "types.h"
+
+#define NO_NODE 0xffffffffU
+
+/**
+ * Briaunų sąrašai, laikomi viename masyve (CSR su atsarga).
+ *
+ * Kiekvieno mazgo briaunos užima ištisinę masyvo atkarpą, todėl jas galima
+ * peržiūrėti neieškant maišos lentelėse ir nešokinėjant po atmintį. Atkarpa
+ * turi atsargą; jei naujas sąrašas netelpa, jis perkeliamas į masyvo galą, o
+ * sena vieta tampa šiukšle. Kai šiukšlių daugiau nei naudojamų briaunų,
+ * masyvas perrašomas iš naujo mazgų numerių tvarka.
+ */
+class EdgeStore
+{
+  public:
+    struct Edge
+    {
+      unsigned       node;
+      unsigned       weight;
+      unsigned short mtu;    // kanalo MTU (žr. NetworkLayer.h)
+    };
+
+  private:
+    struct Range
+    {
+      unsigned start;
+      unsigned count;
+      unsigned capacity;
+    };
+
+  private:
+    vector<Range> mRanges;
+    vector<Edge>  mEdges;
+    unsigned      mGarbage; // kiek mEdges elementų nepriklauso jokiam mazgui
+
+  public:
+    EdgeStore();
+
+    const Edge* begin(unsigned node) const
+    {
+      return node < mRanges.size() ? mEdges.data() + mRanges[node].start
+                                   : NULL;
+    }
+    const Edge* end(unsigned node) const
+    {
+      return node < mRanges.size() ? begin(node) + mRanges[node].count : NULL;
+    }
+    unsigned    count(unsigned node) const
+    {
+      return node < mRanges.size() ? mRanges[node].count : 0;
+    }
+
+    /**
+     * Pakeičia visą mazgo briaunų sąrašą.
+     */
+    void        assign(unsigned node, const Edge* first, const Edge* last);
+    void        add(unsigned node, const Edge& rEdge);
+
+    /**
+     * Pašalina briauną į target (sąrašo tvarka nesaugoma).
+     */
+    void        remove(unsigned node, unsigned target);
+
+    void        clear(unsigned node);
+    size_t      memoryUsage() const;
+
+  private:
+    /**
+     * Užtikrina, kad mazgo atkarpoje tilptų capacity briaunų.
+     */
+    void        reserve(unsigned node, unsigned capacity);
+    void        compact();
+};
+
+/**
+ * Ryšių būsenos duomenų bazė: iš LS paketų sudarytas tinklo grafas.
+ *
+ * Mazgams suteikiami tankūs numeriai (0, 1, 2, ...), kuriais indeksuojami
+ * visi masyvai – taip ir atstumų lentelės gali būti paprasti masyvai.
+ * Numeris suteikiamas mazgui, kai gaunamas jo LS paketas arba jis paminimas
+ * kito mazgo LS pakete, ir atlaisvinamas (release()), kai nebelieka nei jo
+ * LS duomenų, nei į jį vedančių briaunų. Laikomos ir atvirkštinės briaunos.
+ */
+class LinkStateDatabase
+{
+  public:
+    typedef EdgeStore::Edge Edge;
+    typedef vector<Edge>    EdgeList;
+
+    struct NodeInfo
+    {
+      bool     hasState;     // ar gautas (ir dar nepasenęs) LS paketas
+      unsigned sequence;     // LS paketo numeris
+      unsigned baseSequence; // paskutinio pilno LS paketo numeris
+      timespec timeout;      // duomenų galiojimo laikas
+      unsigned lastId;       // siųsto paketo ID
+    };
+
+  private:
+    unordered_map<IpAddress, unsigned> mIds;
+    vector<IpAddress>                  mAddresses;
+    vector<NodeInfo>                   mNodes;
+    vector<unsigned>                   mFree;     // atlaisvinti numeriai
+    EdgeStore                          mOut;
+    EdgeStore                          mIn;
+    unsigned                           mStates;   // kiek mazgų turi LS
+
+  public:
+    LinkStateDatabase();
+
+    /**
+     * @return mazgo numeris arba NO_NODE, jei mazgas nežinomas
+     */
+    unsigned    find(IpAddress address) const;
+
+    /**
+     * @return mazgo numeris (jei reikia, suteikiamas naujas)
+     */
+    unsigned    intern(IpAddress address);
+
+    /**
+     * Priskiria numerį node adresui address (kopijai, kurios numeriai turi
+     * sutapti su kitos duomenų bazės). Kitas šio adreso numeris ir kitas šio
+     * numerio adresas pamirštami.
+     */
+    void        bind(unsigned node, IpAddress address);
+
+    /**
+     * Atlaisvina mazgo numerį, jei mazgas neturi LS duomenų ir į jį neveda
+     * briaunų.
+     *
+     * @return true, jei atlaisvino
+     */
+    bool        release(unsigned node);
+
+    IpAddress   address(unsigned node) const { return mAddresses[node]; }
+    NodeInfo&   info(unsigned node) { return mNodes[node]; }
+
+    /**
+     * @return už visus suteiktus numerius didesnis skaičius (masyvų dydis)
+     */
+    unsigned    size() const { return mAddresses.size(); }
+    unsigned    stateCount() const { return mStates; }
+
+    const Edge* outBegin(unsigned node) const { return mOut.begin(node); }
+    const Edge* outEnd(unsigned node) const { return mOut.end(node); }
+    const Edge* inBegin(unsigned node) const { return mIn.begin(node); }
+    const Edge* inEnd(unsigned node) const { return mIn.end(node); }
+
+    /**
+     * Pakeičia mazgo briaunas (ir atitinkamas atvirkštines briaunas).
+     *
+     * @param rEdges naujos briaunos; į jį įrašomos senosios
+     */
+    void        setEdges(unsigned node, EdgeList& rEdges);
+
+    /**
+     * Pamiršta mazgo LS duomenis.
+     *
+     * @param rOld į jį įrašomos buvusios mazgo briaunos
+     */
+    void        removeState(unsigned node, EdgeList& rOld);
+
+    /**
+     * @return apytikslis užimamos atminties kiekis baitais
+     */
+    size_t      memoryUsage() const;
+};
+
+#endif
@@ -0,0 +1,60 @@
+#include "LinkStatistics.h"
+#include <cstring>
+
+Histogram::Histogram():
+  mCount(0),
+  mSum(0),
+  mMin(0),
+  mMax(0)
+{
+  memset(mBuckets, 0, sizeof(mBuckets));
+}
+
+void Histogram::add(unsigned value)
+{
+  unsigned bucket = 0;
+  for (unsigned v = value; v != 0 && bucket < HISTOGRAM_BUCKETS - 1; v >>= 1)
+  {
+    ++bucket;
+  }
+  ++mBuckets[bucket];
+  if (mCount == 0 || value < mMin) mMin = value;
+  if (value > mMax) mMax = value;
+  ++mCount;
+  mSum += value;
+}
+
+void Histogram::print(FILE* pFile, const char* name) const
+{
+  fprintf(pFile, "  %s: %llu (min %u, vid. %u, maks. %u)", name, mCount, mMin,
+          average(), mMax);
+  unsigned last = HISTOGRAM_BUCKETS;
+  while (last > 0 && mBuckets[last - 1] == 0) --last;
+  for (unsigned i = 0; i < last; i++)
+  {
+    fprintf(pFile, " <%u:%llu", 1U << i, mBuckets[i]);
+  }
+  fprintf(pFile, "\n");
+}
+
+LinkStatistics::LinkStatistics():
+  framesSent(0),
+  framesReceived(0),
+  acksSent(0),
+  retransmissions(0),
+  retriesExhausted(0),
+  duplicates(0),
+  dropped(0),
+  livenessLost(0)
+{ }
+
+void LinkStatistics::print(FILE* pFile, MacAddress neighbour) const
+{
+  fprintf(pFile, "Kaimynas %llx: išsiųsta %llu, gauta %llu, Ack %llu, "
+                 "pakartota %llu, nutraukta %llu, dublikatai %llu, "
+                 "atmesta %llu, prapuolė %llu\n", neighbour, framesSent,
+          framesReceived, acksSent, retransmissions, retriesExhausted,
+          duplicates, dropped, livenessLost);
+  rtt.print(pFile, "RTT, ms");
+  queue.print(pFile, "eilė");
+}
@@ -0,0 +1,55 @@
+#ifndef LINKSTATISTICS_H
+#define LINKSTATISTICS_H
+
+#include <cstdio>
+#include "types.h"
+
+#define HISTOGRAM_BUCKETS 16
+
+/**
+ * Logaritminė histograma: 0-iniame stulpelyje – nuliai, i-tajame – reikšmės
+ * iš intervalo [2^(i-1); 2^i), paskutiniame – ir visos didesnės.
+ */
+class Histogram
+{
+  private:
+    unsigned long long mBuckets[HISTOGRAM_BUCKETS];
+    unsigned long long mCount;
+    unsigned long long mSum;
+    unsigned           mMin;
+    unsigned           mMax;
+
+  public:
+    Histogram();
+
+    void     add(unsigned value);
+    unsigned long long count() const { return mCount; }
+    unsigned min() const { return mMin; }
+    unsigned max() const { return mMax; }
+    unsigned average() const { return mCount ? mSum / mCount : 0; }
+    void     print(FILE* pFile, const char* name) const;
+};
+
+/**
+ * Kanalinio lygio ryšio su vienu kaimynu statistika.
+ * Skaitliukai nenulinami nutrūkus ryšiui, todėl rodo visą laido istoriją.
+ */
+struct LinkStatistics
+{
+  unsigned long long framesSent;       // išsiųsti kadrai su duomenimis
+  unsigned long long framesReceived;   // gauti kadrai (ir tik Ack)
+  unsigned long long acksSent;         // atskirai išsiųsti Ack kadrai
+  unsigned long long retransmissions;  // pakartotinai išsiųsti kadrai
+  unsigned long long retriesExhausted; // kiek kartų ryšys nutrauktas
+  unsigned long long duplicates;       // gauti jau gauti kadrai
+  unsigned long long dropped;          // neįdėti į pilną eilę kadrai
+  unsigned long long livenessLost;     // kiek kartų kaimynas nustojo atsakyti
+  Histogram          rtt;              // nuo pirmo siuntimo iki Ack, ms
+  Histogram          queue;            // eilės ilgis įdedant kadrą
+
+  LinkStatistics();
+
+  void print(FILE* pFile, MacAddress neighbour) const;
+};
+
+#endif
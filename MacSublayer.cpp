@@ -1,6 +1,7 @@
 #include "MacSublayer.h"
 #include "Node.h"
 #include <algorithm>
+#include <cstdio>
 #include <cstring>
 
 #define WHOLE_FRAME_ARRIVED mInputBuffer.size() \
@@ -15,13 +16,18 @@ MacSublayer::MacSublayer(Node* pNode):
   mConsequentOnes(0),
   mLastVoltage(0),
   mPreambleBits(0),
-  mTimersRunning(0),
+  mSignalTimer(0),
   mReceivingData(false),
   mJustArrived(false),
-  mIsZombie(false),
+  mWireBusy(false),
   mLength(0)
 { }
 
+MacSublayer::~MacSublayer()
+{
+  mpNode->cancelTimer(mSignalTimer);
+}
+
 void MacSublayer::fromPhysicalLayer(char voltage)
 {
   //info("Gavo signalą %hhd\n", voltage);
@@ -67,7 +73,7 @@ void MacSublayer::fromPhysicalLayer(char voltage)
   if (mJustArrived)
   {
     mJustArrived = false;
-    mTimersRunning *= -1;
+    mWireBusy = false;
     mReceivingData = false;
     MacAddress source = 0;
     for (int i = 8 * MAC_ADDRESS_LENGTH; i < 2 * 8 * MAC_ADDRESS_LENGTH; i++)
@@ -75,14 +81,14 @@ void MacSublayer::fromPhysicalLayer(char voltage)
       source = (source << 1) + !!mInputBuffer[i];
     }
     info("Gavo %hu ilgio kadrą nuo %llx:\n", mLength, source);
-    Frame frame(mLength);
+    PacketBuffer frame(mLength, 0);
+    Byte* data = frame.data();
     for (int i = 0; i < mLength; i++)
     {
-      frame.data[i] = 0;
+      data[i] = 0;
       for (int j = 0; j < 8; j++)
       {
-        frame.data[i] = (frame.data[i] << 1) + !!mInputBuffer[FRAME_START
-                                                              + i * 8 + j];
+        data[i] = (data[i] << 1) + !!mInputBuffer[FRAME_START + i * 8 + j];
       }
     }
     mInputBuffer.clear();
@@ -91,40 +97,44 @@ void MacSublayer::fromPhysicalLayer(char voltage)
   }
   else
   {
-    mpNode->startTimer(this, SIGNAL_TIMEOUT, 0);
-    if (mTimersRunning < 0) mTimersRunning *= -1;
-    mTimersRunning++;
+    if (!mpNode->restartTimer(mSignalTimer, SIGNAL_TIMEOUT))
+    {
+      mSignalTimer = mpNode->startTimer(this, SIGNAL_TIMEOUT, 0);
+    }
+    mWireBusy = true;
   }
 }
 
-bool MacSublayer::fromLinkLayer(MacAddress destination, Frame* pFrame)
+bool MacSublayer::fromLinkLayer(MacAddress destination, PacketBuffer* pFrame)
 {
-  if (pFrame->length > MAX_DATA_LENGTH)
+  FrameLength length = pFrame->length();
+  if (pFrame->length() > MAX_DATA_LENGTH)
   {
-    info("Nori siųsti per ilgą kadrą (ilgis %hu > %d).\n", pFrame->length,
+    info("Nori siųsti per ilgą kadrą (ilgis %u > %d).\n", pFrame->length(),
          MAX_DATA_LENGTH);
     return false;
   }
-  info("Siunčia %hu ilgio kadrą į %llx:\n", pFrame->length, destination);
+  info("Siunčia %hu ilgio kadrą į %llx:\n", length, destination);
   dumpFrame(*pFrame);
   mOutputBuffer.clear();
   mConsequentOnes = 0;
   bufferAddresss(destination);
   bufferAddresss(mpNode->macAddress());
-  bufferByte((pFrame->length >> 8) & 0xff);
-  bufferByte(pFrame->length & 0xff);
-  for (FrameLength i = 0; i < pFrame->length; i++) bufferByte(pFrame->data[i]);
-  for (FrameLength i = pFrame->length; i < MIN_DATA_LENGTH; i++) bufferByte(0);
+  bufferByte((length >> 8) & 0xff);
+  bufferByte(length & 0xff);
+  Byte* data = pFrame->data();
+  for (FrameLength i = 0; i < length; i++) bufferByte(data[i]);
+  for (FrameLength i = length; i < MIN_DATA_LENGTH; i++) bufferByte(0);
   bufferChecksum();
   return sendBuffer();
 }
 
 bool MacSublayer::sendBuffer()
 {
-  if (mTimersRunning > 0)
+  if (mWireBusy)
   {
-    info("Vyksta gavimas (%lld; %u) – kad nebūtų kolizijos, neleista siųsti.\n",
-         mTimersRunning, mInputBuffer.size());
+    info("Vyksta gavimas (%u) – kad nebūtų kolizijos, neleista siųsti.\n",
+         mInputBuffer.size());
     return false;
   }
   if (!sendPreamble()) return false;
@@ -134,16 +144,8 @@ bool MacSublayer::sendBuffer()
 
 void MacSublayer::timer(long long id)
 {
-  if      (mTimersRunning > 0) --mTimersRunning;
-  else if (mTimersRunning < 0) ++mTimersRunning;
-  else info("Baigėsi laikmatis, nors nebuvo pradėtas.\n");
-  if (mTimersRunning == 0 && mIsZombie) delete this;
-}
-
-void MacSublayer::selfDestruct()
-{
-  if (mTimersRunning) mIsZombie = true;
-  else delete this;
+  mSignalTimer = 0;
+  mWireBusy = false;
 }
 
 void MacSublayer::bufferAddresss(MacAddress macAddress)
@@ -294,16 +296,14 @@ void MacSublayer::receivedBit(bool bit)
   }
 }
 
-void MacSublayer::dumpFrame(Frame& rFrame)
+void MacSublayer::dumpFrame(PacketBuffer& rFrame)
 {
-  char string[rFrame.length * 4 + 4];
-  string[0] = '\0';
-  for (int i = 0; i < rFrame.length; i++)
+  vector<char> string(rFrame.length() * 4 + 2);
+  char* pEnd = &string[0];
+  for (unsigned i = 0; i < rFrame.length(); i++)
   {
-    char current[5];
-    sprintf(current, " %hhu", rFrame.data[i]);
-    strcat(string, current);
+    pEnd += sprintf(pEnd, " %hhu", rFrame.data()[i]);
   }
-  strcat(string, "\n");
-  info(string);
+  strcpy(pEnd, "\n");
+  info("%s", &string[0]);
 }
@@ -3,7 +3,7 @@
 
 #include <vector>
 #include "Layer.h"
-#include "Frame.h"
+#include "PacketBuffer.h"
 
 #define MAX_DATA_LENGTH      1500 // didžiausias kadro duomenų dalies ilgis
 #define MIN_DATA_LENGTH (FrameLength)46 // mažiausias kadro duomenų dalies ilgis
@@ -43,30 +43,28 @@ class MacSublayer: public Layer
     char        mLastVoltage;
     char        mPreambleBits;  // kiek iš 01111110 bitų sekos buvo paskutiniai
                                 // gauti bitai
-    long long   mTimersRunning; // jei teigiamas – siuntimas negalimas, nes eina
-                                // dar mTimersRunning laikmačių; jei neigiamas –
-                                // siuntimas galimas, tačiau dar eina
-                                // -mTimersRunning laikmačių
+    TimerHandle mSignalTimer;   // perkeliamas gavus kiekvieną signalą
     bool        mReceivingData : 1; // ar jau buvo užfiksuota kadro pradžia
     bool        mJustArrived   : 1; // ar ką tik buvo sėkmingai priimtas kadras
-    bool        mIsZombie : 1;  // jei true, bus sunaikintas, kai mTimersRunning
-                                // taps nuliu (kad nebūtų SIGSEGV)
+    bool        mWireBusy      : 1; // ar per paskutines SIGNAL_TIMEOUT ms
+                                    // gauta signalų ir kadras dar nepriimtas
+                                    // (tada siųsti negalima)
     FrameLength mLength;        // priimamų duomenų ilgis
 
   public:
     MacSublayer(Node* pNode);
+    ~MacSublayer();
     void fromPhysicalLayer(char voltage);
 
     /**
      * Siunčia kadrą.
      *
      * @param destination gavėjo MAC adresas
-     * @param frame       rodyklė į kadro baitus
-     * @param length      kadro ilgis baitais
+     * @param pFrame      kadras
      * @return true, jei pavyko išsiųsti, false – priešingu atveju (pavyzdžiui,
      *         tuo metu laidas buvo naudojamas ir norėta išvengti kolizijos)
      */
-    bool fromLinkLayer(MacAddress destination, Frame* pFrame);
+    bool fromLinkLayer(MacAddress destination, PacketBuffer* pFrame);
 
     /**
      * Bando pakartotinai siųsti vėliausiai supakuotą kadrą.
@@ -79,8 +77,6 @@ class MacSublayer: public Layer
 
     void timer(long long id); // žr. Layer.h
 
-    void selfDestruct();
-
   protected:
     const char* layerName()
       { return "MAC polygis"; }
@@ -101,7 +97,7 @@ class MacSublayer: public Layer
      *
      * @param rFrame kadras
      */
-    void dumpFrame(Frame& rFrame);
+    void dumpFrame(PacketBuffer& rFrame);
 };
 
 #endif
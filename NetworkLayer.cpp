@@ -2,63 +2,148 @@
 #include "LinkLayer.h"
 #include "Node.h"
 #include <cstdlib>
+#include <cstring>
 #include <ctime>
 #include <algorithm>
 #include <map>
 
-#define ARP_LENGTH 1 + sizeof(timespec)
+#define ARP_LENGTH      (1 + sizeof(timespec) + 2)
+#define ARP_MTU         (sizeof(Header) + ARP_LENGTH - 2) // MTU vieta pakete
+#define LS_ENTRY_LENGTH 10
+#define LS_PREFIX_LENGTH 11 // numeris, amžius, rūšis ir pilno paketo numeris
+#define LS_AGE           4  // amžiaus vieta LS duomenyse
+#define LS_KIND          6
+#define LS_BASE          7
+#define LS_FULL          0
+#define LS_DELTA         1
+#define LS_SUMMARY       2
+#define SUMMARY_ENTRY_LENGTH 13
+#define HEADER_TTL         1  // antraštės laukų vietos pakete
+#define HEADER_ID          2
+#define HEADER_SOURCE      8
+#define HEADER_DESTINATION 12
+#define MAX_AREA_COST    0xfffffffeU
+#define LS_REMOVED       0xffffffffU // išnykusio kaimyno delsa
+
+/**
+ * @return MTU, pataisytas, kad būtų intervale [MIN_MTU; MAX_MTU]
+ */
+static unsigned clamp_mtu(unsigned mtu)
+{
+  return max(MIN_MTU, min(MAX_MTU, mtu));
+}
+
+/**
+ * @return ar LS paketo numeris a naujesnis už b (žr. NetworkLayer.h)
+ */
+static bool newer_sequence(unsigned a, unsigned b)
+{
+  return (int)(a - b) > 0;
+}
+
+/**
+ * @return ar delsa pasikeitė daugiau, nei leidžia LS_HYSTERESIS
+ */
+static bool significant_change(unsigned oldDelay, unsigned newDelay)
+{
+  unsigned difference = oldDelay > newDelay ? oldDelay - newDelay
+                                            : newDelay - oldDelay;
+  return difference > LS_HYSTERESIS_MIN
+         && difference > (unsigned long long)oldDelay * LS_HYSTERESIS / 100;
+}
+
+/**
+ * Sumaišo srauto požymius į tolygiai pasiskirsčiusį 64 bitų skaičių
+ * (splitmix64 baigiamoji funkcija).
+ */
+static unsigned long long flow_hash(unsigned long long a, unsigned long long b)
+{
+  unsigned long long x = a * 0x9e3779b97f4a7c15ULL ^ b;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+  return x ^ (x >> 31);
+}
 
 NetworkLayer::NetworkLayer(Node* pNode):
   Layer(pNode),
-  mLastTimerId(0),
-  mLastBroadcastId(0)
+  mRouteWorker(pNode->config().spfThreads),
+  mpRoutes(NULL),
+  mLastBroadcastId(0),
+  mBaseSequence(0),
+  mFibChanged(false),
+  mUpdateTimer(0),
+  mHold(pNode->config().spfHold),
+  mReassembly(pNode->config().reassemblyMemory, PACKET_TIMEOUT),
+  mLastAreaId(0)
 {
-  startTimer(LS_PERIOD, TimerType::SEND_LS, NULL);
+  mSelf = mDatabase.intern(mpNode->ipAddress());
+  mArea = areaOf(mpNode->ipAddress());
+  mLastUpdate.tv_sec = 0;
+  mLastUpdate.tv_nsec = 0;
+  mNextFullLs.tv_sec = 0;
+  mNextFullLs.tv_nsec = 0;
+  mLastLs.tv_sec = 0;
+  mLastLs.tv_nsec = 0;
+  timespec now;
+  clock_gettime(CLOCK_REALTIME, &now);
+  mSequence = now.tv_sec * LS_SEQUENCE_RATE
+              + now.tv_nsec / (1000 * MILLION / LS_SEQUENCE_RATE);
+  mLsTimer = startTimer(LS_PERIOD, TimerType::SEND_LS, NULL);
+}
+
+NetworkLayer::~NetworkLayer()
+{
+  delete mpRoutes;
 }
 
 void NetworkLayer::timer(long long id)
 {
-  auto timerIt = mTimers.find(id);
-  if (timerIt == mTimers.end()) return; // atjungtas
-  if (timerIt->second.first == TimerType::SEND_LS)
+  TimerType timerType = TimerType(id & ((1 << TIMER_TYPE_BITS) - 1));
+  if (timerType == TimerType::SEND_LS)
   {
-    info("Siųs LS.\n");
     timespec current;
     clock_gettime(CLOCK_MONOTONIC, &current);
+    mLastLs = current;
     auto it = mArpCache.begin();
     while (it != mArpCache.end())
     {
-      if (it->second.timeout < current) mArpCache.erase(it++);
+      if (it->second.timeout < current)
+      {
+        mArpCache.erase(it++);
+        mFibChanged = true;
+      }
       else ++it;
     }
-    unsigned packetLength = sizeof(Header) + 4 + 8 * mArpCache.size();
-    Byte packet[packetLength];
-    Header header;
-    header.protocol    = LS_PROTOCOL;
-    header.ttl         = BROADCAST_TTL;
-    header.id          = ++mLastBroadcastId;
-    header.length      = packetLength - sizeof(Header);
-    header.offset      = 0;
-    header.source      = mpNode->ipAddress();
-    header.destination = BROADCAST_IP;
-    header.toBytes(packet);
-    int_to_bytes(packet + sizeof(Header), current.tv_sec);
-    it = mArpCache.begin();
-    for (int i = 0; it != mArpCache.end(); it++, ++i)
+    vector<Byte> packet;
+    if (buildLinkState(current, packet))
     {
-      int_to_bytes(packet + sizeof(Header) + 4 + 8 * i, it->first);
-      int_to_bytes(packet + sizeof(Header) + 8 + 8 * i, it->second.responseTime);
+      info("Siųs LS (%s).\n", packet[sizeof(Header) + LS_KIND] == LS_FULL
+                               ? "pilną" : "pokyčių");
+      updateLinkState(mpNode->ipAddress(), &packet[sizeof(Header)],
+                      packet.size() - sizeof(Header));
     }
-    mNodes[mpNode->ipAddress()].update(packet + sizeof(Header),
-                                       packetLength - sizeof(Header));
-    kruskal();
-    for (auto destinationIp : mSpanningTree)
+    else info("Kaimynai reikšmingai nepasikeitė, LS nesiunčiamas.\n");
+    expireNodes();
+    for (auto summaryIt = mSummaries.begin(); summaryIt != mSummaries.end();)
     {
+      if (summaryIt->second.timeout < current)
+      {
+        mSummaries.erase(summaryIt++);
+        mFibChanged = true;
+      }
+      else ++summaryIt;
+    }
+    updateRoutes();
+    unsigned expired = mReassembly.expire(current);
+    if (expired > 0) info("Išmesta nesurinktų paketų: %u.\n", expired);
+    for (auto destinationIp : spanningTree())
+    {
+      if (packet.empty()) break;
       it = mArpCache.find(destinationIp);
       if (it != mArpCache.end())
       {
-        if (it->second.pLinkLayer->fromNetworkLayer(it->second.macAddress,
-                                                    packet, packetLength))
+        if (toLinkLayer(it->second.pLinkLayer, it->second.macAddress,
+                        &packet[0], packet.size(), true))
         {
           info("Išsiųstas LS į %llx.\n", it->second.macAddress);
         }
@@ -70,68 +155,161 @@ void NetworkLayer::timer(long long id)
              destinationIp);
       }
     }
-    startTimer(LS_PERIOD, TimerType::SEND_LS, NULL);
+    for (auto neighbour : mNewNeighbours) mDatabaseCursors[neighbour] = 0;
+    mNewNeighbours.clear();
+    for (auto cursorIt = mDatabaseCursors.begin();
+         cursorIt != mDatabaseCursors.end();)
+    {
+      if (sendDatabase(cursorIt->first, cursorIt->second))
+      {
+        cursorIt = mDatabaseCursors.erase(cursorIt);
+      }
+      else ++cursorIt;
+    }
+    sendSummaries();
+    mLsTimer = startTimer(LS_PERIOD, TimerType::SEND_LS, NULL);
+  }
+  else if (timerType == TimerType::SEND_ARP)
+  {
+    LinkLayer* pLinkLayer = (LinkLayer*)(id >> TIMER_TYPE_BITS);
+    sendArpRequest(pLinkLayer, BROADCAST_MAC, BROADCAST_IP);
+    int period = ARP_PERIOD - rand() % (ARP_PERIOD * ARP_JITTER / 100 + 1);
+    mLinks[pLinkLayer].arpTimer = startTimer(period, TimerType::SEND_ARP,
+                                             pLinkLayer);
   }
-  else if (mLinks.find(timerIt->second.second) == mLinks.end()) return;
+  else if (timerType == TimerType::UPDATE_ROUTES)
+  {
+    mUpdateTimer = 0;
+    updateRoutes();
+  }
+}
 
-  if (timerIt->second.first == TimerType::SEND_ARP)
+void NetworkLayer::sendArpRequest(LinkLayer* pLinkLayer,
+                                  MacAddress macAddress, IpAddress destination)
+{
+  Header header;
+  header.protocol = ARP_PROTOCOL;
+  header.ttl = 0;
+  header.id = ++mLastBroadcastId;
+  header.length = ARP_LENGTH;
+  header.offset = 0;
+  header.source = mpNode->ipAddress();
+  header.destination = destination;
+  PacketBuffer packet(sizeof(Header) + header.length);
+  Byte* data = packet.data();
+  header.toBytes(data);
+  data[sizeof(Header)] = 0;
+  timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  memcpy(data + sizeof(Header) + 1, &time, sizeof(timespec));
+  short_to_bytes(data + ARP_MTU, mpNode->config().mtu);
+  if (toLinkLayer(pLinkLayer, macAddress, packet, true))
   {
-    Header header;
-    header.protocol = ARP_PROTOCOL;
-    header.ttl = 0;
-    header.id = ++mLastBroadcastId;
-    header.length = ARP_LENGTH;
-    header.offset = 0;
-    header.source = mpNode->ipAddress();
-    header.destination = BROADCAST_IP;
-    Byte packet[sizeof(Header) + header.length];
-    header.toBytes(packet);
-    packet[sizeof(Header)] = 0;
-    timespec time;
-    clock_gettime(CLOCK_MONOTONIC, &time);
-    memcpy(packet + sizeof(Header) + 1, &time, sizeof(timespec));
-    if (timerIt->second.second->fromNetworkLayer(BROADCAST_MAC, packet,
-                                                 sizeof(Header)
-                                                 + header.length))
-    {
-      info("Išsiuntė ARP užklausą.\n");
-    }
-    else info("Nepavyko išsiųsti ARP užklausos.\n");
-    startTimer(ARP_PERIOD, TimerType::SEND_ARP, timerIt->second.second);
+    info("Išsiuntė ARP užklausą.\n");
   }
-  mTimers.erase(timerIt);
+  else info("Nepavyko išsiųsti ARP užklausos.\n");
 }
 
 void NetworkLayer::addLink(LinkLayer* pLinkLayer)
 {
-  mLinks.insert(pLinkLayer);
-  startTimer(rand() % ARP_STARTED, TimerType::SEND_ARP, pLinkLayer);
+  mLinks[pLinkLayer].arpTimer = startTimer(0, TimerType::SEND_ARP,
+                                           pLinkLayer);
 }
 
 void NetworkLayer::removeLink(LinkLayer* pLinkLayer)
 {
-  mLinks.erase(pLinkLayer);
-  for (auto it = mTimers.begin(); it != mTimers.end();)
+  auto linkIt = mLinks.find(pLinkLayer);
+  if (linkIt == mLinks.end()) return;
+  mpNode->cancelTimer(linkIt->second.arpTimer);
+  mLinks.erase(linkIt);
+  for (auto it = mArpCache.begin(); it != mArpCache.end();)
+  {
+    if (it->second.pLinkLayer == pLinkLayer)
+    {
+      mArpCache.erase(it++);
+      mFibChanged = true;
+    }
+    else ++it;
+  }
+}
+
+void NetworkLayer::neighbourLost(LinkLayer* pLinkLayer, MacAddress neighbour)
+{
+  auto linkIt = mLinks.find(pLinkLayer);
+  if (linkIt != mLinks.end()) linkIt->second.pending.erase(neighbour);
+  bool lost = false;
+  for (auto it = mArpCache.begin(); it != mArpCache.end();)
+  {
+    if (it->second.pLinkLayer == pLinkLayer
+        && it->second.macAddress == neighbour)
+    {
+      info("Kaimynas %x nebeatsako.\n", it->first);
+      mArpCache.erase(it++);
+      lost = true;
+    }
+    else ++it;
+  }
+  if (!lost) return;
+  mFibChanged = true;
+  triggerLinkState();
+}
+
+void NetworkLayer::triggerLinkState()
+{
+  timespec elapsed;
+  clock_gettime(CLOCK_MONOTONIC, &elapsed);
+  elapsed = elapsed - mLastLs;
+  long long milliseconds = elapsed.tv_sec * 1000LL + elapsed.tv_nsec / MILLION;
+  int delay = milliseconds < LS_MIN_INTERVAL ? LS_MIN_INTERVAL - milliseconds
+                                             : 0;
+  if (mpNode->restartTimer(mLsTimer, delay))
   {
-    if (it->second.second == pLinkLayer) mTimers.erase(it++);
-    else it++;
+    info("LS bus siunčiamas po %d ms.\n", delay);
   }
 }
 
 void NetworkLayer::fromLinkLayer(LinkLayer* pLinkLayer, MacAddress source,
-                                 Byte* packet, FrameLength packetLength)
+                                 PacketBuffer& rPacket)
 {
+  Byte* packet = rPacket.data();
+  FrameLength packetLength = rPacket.length();
+  if (packetLength < sizeof(Header))
+  {
+    info("Per trumpas paketas (%d).\n", packetLength);
+    return;
+  }
+  if (packet[0] != ARP_PROTOCOL && packet[0] != LS_PROTOCOL)
+  {
+    IpAddress destination = bytes_to_int(packet + HEADER_DESTINATION);
+    if (destination != mpNode->ipAddress() && destination != BROADCAST_IP)
+    {
+      info("Paketas skirtas kitam mazgui.\n");
+      forward(rPacket);
+      return;
+    }
+  }
   Header header(packet);
   if (header.protocol == ARP_PROTOCOL)
   {
     switch (packet[sizeof(Header)])
     {
       case 0:
+        if (sizeof(Header) + ARP_LENGTH != packetLength)
+        {
+          info("Blogas ARP užklausos ilgis %d.\n", packetLength);
+          break;
+        }
+        bool newNeighbour;
+        newNeighbour = header.destination == BROADCAST_IP
+                       && mArpCache.find(header.source) == mArpCache.end();
         packet[sizeof(Header)] = 1;
+        short_to_bytes(packet + ARP_MTU,
+                       min(bytes_to_short(packet + ARP_MTU),
+                           (unsigned short)mpNode->config().mtu));
         header.destination = header.source;
         header.source = mpNode->ipAddress();
         header.toBytes(packet);
-        if (pLinkLayer->fromNetworkLayer(source, packet, packetLength))
+        if (toLinkLayer(pLinkLayer, source, rPacket, true))
         {
           info("Gavo ARP užklausą nuo %llx. Išsiuntė atsakymą.\n", source);
         }
@@ -140,6 +318,10 @@ void NetworkLayer::fromLinkLayer(LinkLayer* pLinkLayer, MacAddress source,
           info("Gavo ARP užklausą nuo %llx, bet atsakymo išsiųsti nepavyko.\n",
                source);
         }
+        if (newNeighbour)
+        { // atsakymas į šią užklausą savos nesukels
+          sendArpRequest(pLinkLayer, source, header.destination);
+        }
         break;
       case 1:
         if (sizeof(Header) + ARP_LENGTH != packetLength)
@@ -157,7 +339,19 @@ void NetworkLayer::fromLinkLayer(LinkLayer* pLinkLayer, MacAddress source,
         }
         info("Gavo ARP atsakymą nuo %llx praėjus %ld.%09ld.\n", source,
              responseTime.tv_sec, responseTime.tv_nsec);
-        mArpCache[header.source].update(source, responseTime, time, pLinkLayer);
+        if (mArpCache.find(header.source) == mArpCache.end())
+        { // naujas kaimynas
+          mFibChanged = true;
+          mNewNeighbours.insert(header.source);
+          triggerLinkState();
+        }
+        if (mArpCache[header.source].update(source, responseTime, time,
+                                            pLinkLayer,
+                                            clamp_mtu(bytes_to_short(packet
+                                                                 + ARP_MTU))))
+        {
+          mFibChanged = true; // pasikeitė kaina ar MTU iki kaimyno
+        }
         break;
       default:
         info("Klaida: blogas pirmas ARP baitas.");
@@ -167,47 +361,69 @@ void NetworkLayer::fromLinkLayer(LinkLayer* pLinkLayer, MacAddress source,
   else if (header.destination == BROADCAST_IP)
   {
     info("Gautas visiems skirtas paketas nuo %x.\n", header.source);
+    if (header.protocol == LS_PROTOCOL && areaOf(header.source) != mArea)
+    { // kitos srities LS nepersiunčiami, priimama tik kaimyno santrauka
+      if (packetLength >= sizeof(Header) + LS_PREFIX_LENGTH
+          && packet[sizeof(Header) + LS_KIND] == LS_SUMMARY
+          && updateSummary(header.source, packet + sizeof(Header),
+                           packetLength - sizeof(Header)))
+      {
+        info("Gauta kitos srities mazgo %x santrauka.\n", header.source);
+      }
+      else info("Kitos srities mazgo %x LS paketas atmestas.\n", header.source);
+      return;
+    }
+    if (header.protocol == LS_PROTOCOL
+        && packetLength >= sizeof(Header) + LS_PREFIX_LENGTH)
+    {
+      unsigned short age = bytes_to_short(packet + sizeof(Header) + LS_AGE);
+      if (age < LS_MAX_AGE) short_to_bytes(packet + sizeof(Header) + LS_AGE,
+                                           age + 1);
+    }
     if (header.ttl > 0)
     {
       --header.ttl;
       header.toBytes(packet);
-      for (auto ip : mSpanningTree)
-      {
-        auto it = mArpCache.find(ip);
-        if (it == mArpCache.end())
-        {
-          info("Nerastas kaimyno %x MAC adresas.\n", ip);
-        }
-        else if (it->second.macAddress != source)
-        {
-          if (it->second.pLinkLayer->fromNetworkLayer(it->second.macAddress,
-                                                      packet, packetLength))
-          {
-            info("Visiems skirtas paketas persiųstas į %x.\n", ip);
-          }
-          else info("Visiems skirto paketo persiųsti į %x nepavyko.\n", ip);
-        }
-      }
+      flood(packet, packetLength, source, header.isControl());
       ++header.ttl;
       header.toBytes(packet);
     }
   }
-  if (header.protocol == LS_PROTOCOL)
+  if (header.protocol == LS_PROTOCOL
+      && packetLength >= sizeof(Header) + LS_PREFIX_LENGTH
+      && packet[sizeof(Header) + LS_KIND] == LS_SUMMARY)
   {
-    if (mNodes[header.source].update(packet + sizeof(Header), packetLength
-                                                          - sizeof(Header)))
+    if (updateSummary(header.source, packet + sizeof(Header),
+                      packetLength - sizeof(Header)))
+    {
+      info("Atnaujinta mazgo %x santrauka.\n", header.source);
+    }
+    else info("Gauta sena mazgo %x santrauka.\n", header.source);
+  }
+  else if (header.protocol == LS_PROTOCOL)
+  {
+    if (updateLinkState(header.source, packet + sizeof(Header),
+                        packetLength - sizeof(Header)))
     {
       info("Atnaujinti mazgo %x duomenys.\n", header.source);
-      kruskal();
-      dijkstras();
+      if (header.destination != BROADCAST_IP)
+      { // duomenų bazės mainai: naujesnių duomenų kiti dar neturi
+        header.ttl = BROADCAST_TTL - 1;
+        header.destination = BROADCAST_IP;
+        header.toBytes(packet);
+        Byte* pAge = packet + sizeof(Header) + LS_AGE;
+        unsigned short age = bytes_to_short(pAge);
+        if (age < LS_MAX_AGE) short_to_bytes(pAge, age + 1);
+        flood(packet, packetLength, source, true);
+      }
+      expireNodes();
     }
     else
     {
       info("Gauti seni mazgo %x duomenys.\n", header.source);
     }
   }
-  else if (header.destination == mpNode->ipAddress()
-           || header.destination == BROADCAST_IP)
+  else
   {
     if (header.length + sizeof(Header) == packetLength)
     {
@@ -218,40 +434,34 @@ void NetworkLayer::fromLinkLayer(LinkLayer* pLinkLayer, MacAddress source,
     {
       info("Gautas %hu ilgio paketo fragmentas [%hu; %hu).\n", header.length,
            header.offset, header.offset + packetLength - sizeof(Header));
-      auto it = mFragments.find(make_pair(header.source, header.id));
-      if (it == mFragments.end())
+      timespec current;
+      clock_gettime(CLOCK_MONOTONIC, &current);
+      unsigned evicted = mReassembly.evicted();
+      Fragment* pPacket = mReassembly.add(header.source, header.id,
+                                          header.length,
+                                          packet + sizeof(Header),
+                                          header.offset,
+                                          packetLength - sizeof(Header),
+                                          current);
+      if (evicted != mReassembly.evicted())
       {
-        mFragments.insert(make_pair(make_pair(header.source, header.id),
-                                    new Fragment(header.length,
-                                             packet + sizeof(Header),
-                                             header.offset,
-                                             packetLength - sizeof(Header))));
+        info("Trūko atminties, išmesta nesurinktų paketų: %u.\n",
+             mReassembly.evicted() - evicted);
       }
-      else
+      if (pPacket != NULL)
       {
-        it->second->add(header.length, packet + sizeof(Header), header.offset,
-                        packetLength - sizeof(Header));
-        if (it->second->isComplete())
-        {
-          mpNode->toTransportLayer(header.source, it->second->data(),
-                                   header.length);
-          delete it->second;
-          mFragments.erase(it);
-        }
+        mpNode->toTransportLayer(header.source, pPacket->data(),
+                                 header.length);
+        mReassembly.remove(header.source, header.id);
       }
     }
   }
-  else
-  {
-    info("Paketas skirtas kitam mazgui.\n");
-    --header.ttl;
-    route(header, packet, packetLength);
-  }
 }
 
-bool NetworkLayer::fromTransportLayer(IpAddress destination, Byte* tpdu,
-                                      unsigned length)
+bool NetworkLayer::fromTransportLayer(IpAddress destination,
+                                      PacketBuffer& rTpdu)
 {
+  unsigned length = rTpdu.length();
   info("Gautas %u ilgio paketas iš transporto lygio, adresuotas %x.\n",
        length, destination);
   if (destination == mpNode->ipAddress())
@@ -259,14 +469,15 @@ bool NetworkLayer::fromTransportLayer(IpAddress destination, Byte* tpdu,
     info("Gavėjas lygus siuntėjui, nesiunčiama.\n");
     return false;
   }
-  if (mNodes.find(destination) == mNodes.end() && destination != BROADCAST_IP)
+  bool otherArea = destination != BROADCAST_IP
+                   && areaOf(destination) != mArea;
+  if (mDatabase.find(destination) == NO_NODE && destination != BROADCAST_IP
+      && !otherArea)
   {
     info("Nežinomas adresatas.\n");
     return false;
   }
-  Byte packet[sizeof(Header) + length];
-  Byte* pPacket = packet;
-  memcpy(packet + sizeof(Header), tpdu, length);
+  Byte* pPacket = rTpdu.push(sizeof(Header));
   Header header;
   header.protocol = TRANSPORT_PROTOCOL;
   header.length = length;
@@ -278,23 +489,21 @@ bool NetworkLayer::fromTransportLayer(IpAddress destination, Byte* tpdu,
     info("Siunčia visiems.\n");
     header.ttl = BROADCAST_TTL;
     header.id = ++mLastBroadcastId;
-    header.toBytes(packet);
     bool sent = false;
     do
     {
       info("offset = %hu\n", header.offset);
-      unsigned currentLength = min(MAX_PACKET_SIZE,
-                                   length + unsigned(sizeof(Header)));
+      unsigned currentLength = fragmentLength(MIN_MTU,
+                                              length + sizeof(Header));
       header.toBytes(pPacket);
-      for (auto ip : mSpanningTree)
+      for (auto ip : spanningTree())
       {
         auto it = mArpCache.find(ip);
         if (it == mArpCache.end()) info("Nerastas kaimyno %x MAC adresas.\n", ip);
         else
         {
-          if (it->second.pLinkLayer->fromNetworkLayer(it->second.macAddress,
-                                                      pPacket,
-                                                      currentLength))
+          if (toLinkLayer(it->second.pLinkLayer, it->second.macAddress,
+                          pPacket, currentLength))
           {
             info("Visiems skirtas paketas išsiųstas į %x.\n", ip);
             sent = true;
@@ -311,203 +520,770 @@ bool NetworkLayer::fromTransportLayer(IpAddress destination, Byte* tpdu,
   }
   else
   {
-    auto nodeIt = mNodes.find(destination);
-    if (nodeIt != mNodes.end())
+    unsigned node = mDatabase.find(destination);
+    if (node != NO_NODE)
+    {
+      header.id = ++mDatabase.info(node).lastId;
+      return route(header, rTpdu);
+    }
+    if (otherArea)
     {
-      header.id = ++(nodeIt->second.lastId);
-      return route(header, packet, sizeof(Header) + length);
+      header.id = ++mLastAreaId;
+      return route(header, rTpdu);
     }
     info("Adresato mazgas nerastas, nesiunčiama.\n");
     return false;
   }
 }
 
-void NetworkLayer::startTimer(int timeout, TimerType timerType,
-                              LinkLayer* pLinkLayer)
+void NetworkLayer::linkReady(LinkLayer* pLinkLayer, MacAddress destination)
+{
+  for (auto cursorIt = mDatabaseCursors.begin();
+       cursorIt != mDatabaseCursors.end();)
+  {
+    auto arpIt = mArpCache.find(cursorIt->first);
+    if (arpIt == mArpCache.end()
+        || (arpIt->second.pLinkLayer == pLinkLayer
+            && arpIt->second.macAddress == destination))
+    {
+      if (sendDatabase(cursorIt->first, cursorIt->second))
+      {
+        cursorIt = mDatabaseCursors.erase(cursorIt);
+        continue;
+      }
+    }
+    ++cursorIt;
+  }
+  auto linkIt = mLinks.find(pLinkLayer);
+  if (linkIt == mLinks.end()) return;
+  auto pendingIt = linkIt->second.pending.find(destination);
+  if (pendingIt == linkIt->second.pending.end()) return;
+  PacketQueue& rQueue = pendingIt->second;
+  while (!rQueue.empty())
+  {
+    if (!pLinkLayer->fromNetworkLayer(destination, rQueue.front()))
+    { // vėl pilna – pranešus dar kartą bus tęsiama
+      return;
+    }
+    rQueue.pop_front();
+  }
+  info("Laukę paketai į %llx perduoti kanaliniam lygiui.\n", destination);
+  linkIt->second.pending.erase(pendingIt);
+}
+
+bool NetworkLayer::toLinkLayer(LinkLayer* pLinkLayer, MacAddress destination,
+                               PacketBuffer& rPacket, bool isControl)
+{
+  if (isControl)
+  {
+    return pLinkLayer->fromNetworkLayer(destination, rPacket, true);
+  }
+  Link& rLink = mLinks[pLinkLayer];
+  auto pendingIt = rLink.pending.find(destination);
+  if (pendingIt == rLink.pending.end())
+  {
+    if (pLinkLayer->fromNetworkLayer(destination, rPacket)) return true;
+    if (rPacket.length() > MAX_DATA_LENGTH - 1) return false;
+    pendingIt = rLink.pending.insert(make_pair(destination,
+                                               PacketQueue())).first;
+  }
+  if (pendingIt->second.size() >= mpNode->config().pendingQueueSize)
+  {
+    info("Laukiančių paketų į %llx eilė pilna.\n", destination);
+    return false;
+  }
+  pendingIt->second.emplace_back();
+  pendingIt->second.back().swap(rPacket);
+  return true;
+}
+
+bool NetworkLayer::toLinkLayer(LinkLayer* pLinkLayer, MacAddress destination,
+                               const Byte* packet, unsigned length,
+                               bool isControl)
+{
+  PacketBuffer copy(packet, length);
+  return toLinkLayer(pLinkLayer, destination, copy, isControl);
+}
+
+TimerHandle NetworkLayer::startTimer(int timeout, TimerType timerType,
+                                     LinkLayer* pLinkLayer)
 {
-  mpNode->startTimer(this, timeout, ++mLastTimerId);
-  mTimers.insert(make_pair(mLastTimerId, make_pair(timerType, pLinkLayer)));
+  return mpNode->startTimer(this, timeout,
+                            ((long long)pLinkLayer << TIMER_TYPE_BITS)
+                            | (long long)timerType);
 }
 
-void NetworkLayer::kruskal()
+bool NetworkLayer::sendDatabase(IpAddress neighbour, unsigned& rNext)
 {
+  auto it = mArpCache.find(neighbour);
+  if (it == mArpCache.end() || areaOf(neighbour) != mArea) return true;
   timespec current;
   clock_gettime(CLOCK_MONOTONIC, &current);
-  mSpanningTree.clear();
-  vector<pair<IpAddress, pair<IpAddress, unsigned> > > edges;
-  for (auto it = mNodes.begin(); it != mNodes.end();)
+  vector<Byte> packet;
+  unsigned sent = 0;
+  for (; rNext < mDatabase.size(); rNext++)
   {
-    if (it->second.timeout < current)
+    unsigned node = rNext;
+    LinkStateDatabase::NodeInfo& rInfo = mDatabase.info(node);
+    if (!rInfo.hasState || mDatabase.address(node) == neighbour) continue;
+    timespec remaining = rInfo.timeout - current;
+    long long milliseconds = remaining.tv_sec * 1000LL
+                             + remaining.tv_nsec / MILLION;
+    if (milliseconds <= 0) continue;
+    long long age = (LS_TIMEOUT - milliseconds + 999) / 1000;
+    if (age >= LS_MAX_AGE) continue;
+    const Edge* pBegin = mDatabase.outBegin(node);
+    const Edge* pEnd = mDatabase.outEnd(node);
+    packet.resize(sizeof(Header) + LS_PREFIX_LENGTH
+                  + LS_ENTRY_LENGTH * (pEnd - pBegin));
+    Header header;
+    header.protocol    = LS_PROTOCOL;
+    header.ttl         = 0;
+    header.id          = ++mLastBroadcastId;
+    header.length      = packet.size() - sizeof(Header);
+    header.offset      = 0;
+    header.source      = mDatabase.address(node);
+    header.destination = neighbour;
+    header.toBytes(&packet[0]);
+    Byte* pData = &packet[sizeof(Header)];
+    int_to_bytes(pData, rInfo.sequence);
+    short_to_bytes(pData + LS_AGE, age);
+    pData[LS_KIND] = LS_FULL;
+    int_to_bytes(pData + LS_BASE, rInfo.baseSequence);
+    Byte* pEntry = pData + LS_PREFIX_LENGTH;
+    for (const Edge* pEdge = pBegin; pEdge != pEnd; pEdge++)
     {
-      mNodes.erase(it++);
-      continue;
+      int_to_bytes(pEntry, mDatabase.address(pEdge->node));
+      int_to_bytes(pEntry + 4, pEdge->weight);
+      short_to_bytes(pEntry + 8, pEdge->mtu);
+      pEntry += LS_ENTRY_LENGTH;
     }
-    it->second.kruskalSet = it->first;
-    for (auto& edge : it->second.neighbours)
+    if (packet.size() > MAX_DATA_LENGTH - 1) continue; // netilptų į kadrą
+    if (!toLinkLayer(it->second.pLinkLayer, it->second.macAddress,
+                     &packet[0], packet.size(), true))
     {
-      edges.push_back(make_pair(edge.second, make_pair(it->first, edge.first)));
+      info("Naujam kaimynui %x išsiųsta %u duomenų bazės mazgų, tęsiama "
+           "atsiradus vietos eilėje.\n", neighbour, sent);
+      return false;
     }
-    ++it;
+    ++sent;
   }
-  sort(edges.begin(), edges.end());
-  for (auto& edge : edges)
+  info("Naujam kaimynui %x baigta siųsti duomenų bazė (%u mazgų).\n",
+       neighbour, sent);
+  return true;
+}
+
+void NetworkLayer::flood(Byte* packet, unsigned length, MacAddress except,
+                         bool control)
+{
+  for (auto ip : spanningTree())
   {
-    unsigned setA = kruskalSetOf(edge.second.first);
-    unsigned setB = kruskalSetOf(edge.second.second);
-    if (setA != setB)
+    auto it = mArpCache.find(ip);
+    if (it == mArpCache.end())
     {
-      if (setA < setB) mNodes[edge.second.second].kruskalSet = setA;
-      else mNodes[edge.second.first].kruskalSet = setB;
-
-      if (edge.second.second == mpNode->ipAddress())
+      info("Nerastas kaimyno %x MAC adresas.\n", ip);
+    }
+    else if (it->second.macAddress != except)
+    {
+      if (toLinkLayer(it->second.pLinkLayer, it->second.macAddress,
+                      packet, length, control))
       {
-        mSpanningTree.insert(edge.second.first);
+        info("Visiems skirtas paketas persiųstas į %x.\n", ip);
       }
-      else if (edge.second.first == mpNode->ipAddress())
+      else info("Visiems skirto paketo persiųsti į %x nepavyko.\n", ip);
+    }
+  }
+}
+
+bool NetworkLayer::buildLinkState(const timespec& rCurrent,
+                                  vector<Byte>& rPacket)
+{
+  bool changed = false, added = false;
+  for (auto& arpCache : mArpCache)
+  {
+    if (areaOf(arpCache.first) != mArea) continue;
+    Adjacency current = { arpCache.second.responseTime, arpCache.second.mtu };
+    auto it = mAdvertised.find(arpCache.first);
+    if (it == mAdvertised.end()) added = true;
+    else if (it->second.mtu == current.mtu
+             && !significant_change(it->second.delay, current.delay))
+    {
+      continue;
+    }
+    mAdvertised[arpCache.first] = current;
+    mTouched.insert(arpCache.first);
+    changed = true;
+  }
+  for (auto it = mAdvertised.begin(); it != mAdvertised.end();)
+  {
+    if (mArpCache.find(it->first) != mArpCache.end()) ++it;
+    else
+    {
+      mTouched.insert(it->first);
+      mAdvertised.erase(it++);
+      changed = true;
+    }
+  }
+  // naujas kaimynas (ir už jo esantys mazgai) pilno paketo dar neturi
+  bool full = added || !(rCurrent < mNextFullLs)
+              || (!mTouched.empty() && mTouched.size() >= mAdvertised.size());
+  if (!changed && !full) return false;
+  unsigned sequence = ++mSequence;
+  if (full)
+  {
+    mAdvertised.clear();
+    for (auto& arpCache : mArpCache)
+    {
+      if (areaOf(arpCache.first) != mArea) continue;
+      Adjacency current = { arpCache.second.responseTime,
+                            arpCache.second.mtu };
+      mAdvertised[arpCache.first] = current;
+    }
+    mTouched.clear();
+    mBaseSequence = sequence;
+    mNextFullLs = rCurrent;
+    add_milliseconds(mNextFullLs, LS_REFRESH_PERIOD);
+  }
+  unsigned entries = full ? mAdvertised.size() : mTouched.size();
+  rPacket.resize(sizeof(Header) + LS_PREFIX_LENGTH + LS_ENTRY_LENGTH * entries);
+  Header header;
+  header.protocol    = LS_PROTOCOL;
+  header.ttl         = BROADCAST_TTL;
+  header.id          = ++mLastBroadcastId;
+  header.length      = rPacket.size() - sizeof(Header);
+  header.offset      = 0;
+  header.source      = mpNode->ipAddress();
+  header.destination = BROADCAST_IP;
+  header.toBytes(&rPacket[0]);
+  Byte* pData = &rPacket[sizeof(Header)];
+  int_to_bytes(pData, sequence);
+  short_to_bytes(pData + LS_AGE, 0);
+  pData[LS_KIND] = full ? LS_FULL : LS_DELTA;
+  int_to_bytes(pData + LS_BASE, mBaseSequence);
+  Byte* pEntry = pData + LS_PREFIX_LENGTH;
+  if (full)
+  {
+    for (auto& rAdjacency : mAdvertised)
+    {
+      int_to_bytes(pEntry, rAdjacency.first);
+      int_to_bytes(pEntry + 4, rAdjacency.second.delay);
+      short_to_bytes(pEntry + 8, rAdjacency.second.mtu);
+      pEntry += LS_ENTRY_LENGTH;
+    }
+  }
+  else
+  {
+    for (auto address : mTouched)
+    {
+      auto it = mAdvertised.find(address);
+      int_to_bytes(pEntry, address);
+      int_to_bytes(pEntry + 4, it == mAdvertised.end() ? LS_REMOVED
+                                                       : it->second.delay);
+      short_to_bytes(pEntry + 8, it == mAdvertised.end() ? 0 : it->second.mtu);
+      pEntry += LS_ENTRY_LENGTH;
+    }
+  }
+  return true;
+}
+
+bool NetworkLayer::updateLinkState(IpAddress source, Byte* data, int length)
+{
+  unsigned node = mDatabase.find(source);
+  if (length < LS_PREFIX_LENGTH
+      || (length - LS_PREFIX_LENGTH) % LS_ENTRY_LENGTH != 0
+      || bytes_to_short(data + LS_AGE) >= LS_MAX_AGE
+      || (node != NO_NODE && mDatabase.info(node).hasState
+          && !newer_sequence(bytes_to_int(data),
+                             mDatabase.info(node).sequence)))
+  {
+    return false;
+  }
+  bool full = data[LS_KIND] == LS_FULL;
+  if (!full && (node == NO_NODE || !mDatabase.info(node).hasState
+                || mDatabase.info(node).baseSequence
+                   != bytes_to_int(data + LS_BASE)))
+  {
+    info("Gauti mazgo %x pokyčiai, bet nėra jų pagrindo.\n", source);
+    return false;
+  }
+  if (node == NO_NODE) node = mDatabase.intern(source);
+  LinkStateDatabase::NodeInfo& rInfo = mDatabase.info(node);
+  rInfo.sequence = bytes_to_int(data);
+  if (full) rInfo.baseSequence = bytes_to_int(data + LS_BASE);
+  clock_gettime(CLOCK_MONOTONIC, &rInfo.timeout);
+  add_milliseconds(rInfo.timeout,
+                   LS_TIMEOUT - 1000 * bytes_to_short(data + LS_AGE));
+  EdgeList edges;
+  if (!full) edges.assign(mDatabase.outBegin(node), mDatabase.outEnd(node));
+  for (int i = LS_PREFIX_LENGTH; i < length; i += LS_ENTRY_LENGTH)
+  {
+    IpAddress address = bytes_to_int(data + i);
+    unsigned weight = bytes_to_int(data + i + 4);
+    Edge edge;
+    edge.node = weight == LS_REMOVED ? mDatabase.find(address)
+                                     : mDatabase.intern(address);
+    edge.weight = weight;
+    edge.mtu = clamp_mtu(bytes_to_short(data + i + 8));
+    auto it = edges.begin();
+    if (!full)
+    {
+      while (it != edges.end() && it->node != edge.node) ++it;
+    }
+    else it = edges.end();
+    if (weight == LS_REMOVED)
+    {
+      if (it != edges.end())
       {
-        mSpanningTree.insert(edge.second.second);
+        *it = edges.back();
+        edges.pop_back();
       }
     }
+    else if (it != edges.end()) *it = edge;
+    else edges.push_back(edge);
   }
-  info("Atnaujintas minimalus jungiamasis medis (%u).\n", mSpanningTree.size());
+  mDatabase.setEdges(node, edges);
+  linkStateChanged(node, edges);
+  return true;
 }
 
-unsigned NetworkLayer::kruskalSetOf(IpAddress node)
+void NetworkLayer::expireNodes()
 {
-  for (unsigned kruskalSet = mNodes[node].kruskalSet;
-       kruskalSet != node && kruskalSet != BROADCAST_IP;
-       node = kruskalSet, kruskalSet = mNodes[node].kruskalSet);
-  return node;
+  timespec current;
+  clock_gettime(CLOCK_MONOTONIC, &current);
+  EdgeList old;
+  for (unsigned node = 0; node < mDatabase.size(); node++)
+  {
+    LinkStateDatabase::NodeInfo& rInfo = mDatabase.info(node);
+    if (rInfo.hasState && rInfo.timeout < current)
+    {
+      mDatabase.removeState(node, old);
+      linkStateChanged(node, old);
+    }
+  }
 }
 
-void NetworkLayer::dijkstras()
+void NetworkLayer::linkStateChanged(unsigned node, const EdgeList& rOld)
 {
-  for (auto& arpCache : mArpCache)
+  // įsimenamos briaunos prieš pirmą pasikeitimą
+  mChanges.insert(make_pair(node, rOld));
+  if (mUpdateTimer != 0) return;
+  timespec current;
+  clock_gettime(CLOCK_MONOTONIC, &current);
+  timespec elapsed = current - mLastUpdate;
+  long long sinceUpdate = elapsed.tv_sec * 1000LL + elapsed.tv_nsec / MILLION;
+  const Config& rConfig = mpNode->config();
+  long long delay = rConfig.spfDelay;
+  if (sinceUpdate >= rConfig.spfMaxHold) mHold = rConfig.spfHold;
+  else
   {
-    dijkstra(arpCache.first, arpCache.second.distances);
+    if (delay < mHold - sinceUpdate) delay = mHold - sinceUpdate;
+    mHold = min(mHold * 2, (int)rConfig.spfMaxHold);
   }
+  mUpdateTimer = startTimer(delay, TimerType::UPDATE_ROUTES, NULL);
 }
 
-void NetworkLayer::dijkstra(IpAddress root, DistanceMap& rDistances)
+void NetworkLayer::updateRoutes()
 {
-  rDistances.clear();
-  NodeInfo& rRootNode = mNodes[root];
-  multimap<Distance, IpAddress> priorityQueue;
-  for (auto& rNeighbour : rRootNode.neighbours)
+  if (mUpdateTimer != 0)
   {
-    if (rNeighbour.first == mpNode->ipAddress()
-        || mArpCache.find(rNeighbour.first) != mArpCache.end()) continue;
-    Distance distance;
-    distance.delay = rNeighbour.second + CONSTANT_WEIGTH;
-    distance.hops = 1;
-    rDistances.insert(make_pair(rNeighbour.first, distance));
-    priorityQueue.insert(make_pair(distance, rNeighbour.first));
+    mpNode->cancelTimer(mUpdateTimer);
+    mUpdateTimer = 0;
   }
-  for (; !priorityQueue.empty(); priorityQueue.erase(priorityQueue.begin()))
+  clock_gettime(CLOCK_MONOTONIC, &mLastUpdate);
+  if (mChanges.empty())
   {
-    Distance distance = rDistances.find(priorityQueue.begin()->second)->second;
-    if (distance < priorityQueue.begin()->first) continue;
-    auto& rNeighbours = mNodes[priorityQueue.begin()->second].neighbours;
-    for (auto& rNeighbour : rNeighbours)
-    {
-      if (rNeighbour.first == mpNode->ipAddress()
-          || mArpCache.find(rNeighbour.first) != mArpCache.end()) continue;
-      DistanceMap::iterator it = rDistances.find(rNeighbour.first);
-      if (it == rDistances.end())
-      {
-        rDistances.insert(make_pair(rNeighbour.first,
-                                    distance + rNeighbour.second));
-      }
-      else if (distance + rNeighbour.second < it->second)
+    if (mFibChanged) submitRoutes(false);
+    return;
+  }
+  info("Perskaičiuojami maršrutai (pasikeitė %u mazgų).\n", mChanges.size());
+  submitRoutes(true);
+}
+
+void NetworkLayer::submitRoutes(bool withChanges)
+{
+  mFibChanged = false;
+  for (auto& arpCache : mArpCache) mDatabase.intern(arpCache.first);
+  RouteWorker::Job* pJob = new RouteWorker::Job;
+  pJob->self = mSelf;
+  pJob->nodes.push_back(make_pair(mSelf, mDatabase.address(mSelf)));
+  pJob->areaPrefix = mpNode->config().areaPrefix;
+  for (auto& arpCache : mArpCache)
+  {
+    RouteWorker::Neighbour neighbour = { arpCache.first,
+                                         arpCache.second.responseTime,
+                                         arpCache.second.mtu,
+                                         arpCache.second.pLinkLayer };
+    pJob->neighbours.push_back(neighbour);
+    pJob->nodes.push_back(make_pair(mDatabase.find(arpCache.first),
+                                    arpCache.first));
+  }
+  for (auto& rSummary : mSummaries)
+  {
+    pJob->summaries[rSummary.first] = rSummary.second.routes;
+  }
+  if (withChanges)
+  {
+    for (auto& rChange : mChanges)
+    { // gijos kopijai – tik pasikeitusių mazgų briaunos
+      unsigned node = rChange.first;
+      EdgeList& rEdges = pJob->changes[node];
+      rEdges.assign(mDatabase.outBegin(node), mDatabase.outEnd(node));
+      pJob->nodes.push_back(make_pair(node, mDatabase.address(node)));
+      for (auto& rEdge : rEdges)
       {
-        it->second = distance + rNeighbour.second;
-        priorityQueue.insert(make_pair(it->second, rNeighbour.first));
+        pJob->nodes.push_back(make_pair(rEdge.node,
+                                        mDatabase.address(rEdge.node)));
       }
     }
+    // gijos kopijoje į nebereikalingus mazgus neliks briaunų, o vėl suteiktus
+    // numerius kita užduotis susies su naujais adresais, todėl juos galima
+    // atlaisvinti jau dabar
+    for (auto& rChange : mChanges)
+    {
+      for (auto& rEdge : rChange.second) releaseIfUnused(rEdge.node);
+      releaseIfUnused(rChange.first);
+    }
+    mChanges.clear();
   }
+  mRouteWorker.submit(pJob);
 }
 
-bool NetworkLayer::route(Header& rHeader, Byte* packet, unsigned length)
+const NetworkLayer::RouteTable* NetworkLayer::routes()
 {
-  vector<pair<IpAddress, Distance> > ipDistance;
-  vector<double> weights;
-  double totalWeight = 0;
-  auto it = mArpCache.find(rHeader.destination);
-  if (it == mArpCache.end())
+  RouteTable* pRoutes = mRouteWorker.collect();
+  if (pRoutes != NULL)
+  {
+    delete mpRoutes;
+    mpRoutes = pRoutes;
+    info("Atnaujinta persiuntimo lentelė (%u kelių, medyje %u kaimynų).\n",
+         mpRoutes->nextHops.size(), mpRoutes->spanningTree.size());
+  }
+  return mpRoutes;
+}
+
+const unordered_set<IpAddress>& NetworkLayer::spanningTree()
+{
+  static const unordered_set<IpAddress> empty;
+  const RouteTable* pRoutes = routes();
+  return pRoutes == NULL ? empty : pRoutes->spanningTree;
+}
+
+void NetworkLayer::releaseIfUnused(unsigned node)
+{
+  if (node == mSelf || mArpCache.count(mDatabase.address(node)) > 0) return;
+  mDatabase.release(node);
+}
+
+unsigned NetworkLayer::areaOf(IpAddress address)
+{
+  return RouteWorker::areaOf(address, mpNode->config().areaPrefix);
+}
+
+void NetworkLayer::addRoute(map<unsigned, AreaRoute>& rRoutes, unsigned area,
+                            unsigned long long cost, unsigned via,
+                            unsigned hops)
+{
+  if (cost > MAX_AREA_COST || hops > AREA_MAX_HOPS) return;
+  auto it = rRoutes.find(area);
+  if (it != rRoutes.end() && it->second.cost <= cost) return;
+  AreaRoute route = { area, (unsigned)cost, via, hops };
+  rRoutes[area] = route;
+}
+
+void NetworkLayer::summarize(map<unsigned, AreaRoute>& rRoutes,
+                             bool allBorders)
+{
+  rRoutes.clear();
+  for (auto& arpCache : mArpCache)
   {
-    if (mNodes.find(rHeader.destination) == mNodes.end())
+    unsigned area = areaOf(arpCache.first);
+    if (area == mArea) continue;
+    unsigned long long delay = arpCache.second.responseTime + CONSTANT_WEIGTH;
+    addRoute(rRoutes, area, delay, area, 1);
+    auto it = mSummaries.find(arpCache.first);
+    if (it == mSummaries.end()) continue;
+    for (auto& rRoute : it->second.routes)
     {
-      info("Nerastas kelias į adresato mazgą, paketas neišsiųstas.\n");
-      return false;
+      if (rRoute.area == mArea) continue;
+      addRoute(rRoutes, rRoute.area, delay + rRoute.cost, area,
+               rRoute.hops + 1);
     }
-    unsigned long long maxDistance = 0;
-    for (auto& arpCache : mArpCache)
+  }
+  const RouteTable* pRoutes = routes();
+  if (!allBorders || pRoutes == NULL) return;
+  for (auto& rSummary : mSummaries)
+  {
+    if (areaOf(rSummary.first) != mArea) continue;
+    unsigned node = pRoutes->find(rSummary.first,
+                                  mDatabase.find(rSummary.first));
+    unsigned long long distance = pRoutes->distanceFromSelf(node);
+    if (distance == INFINITE_DELAY) continue;
+    for (auto& rRoute : rSummary.second.routes)
     {
-      auto distanceIt = arpCache.second.distances.find(rHeader.destination);
-      if (distanceIt != arpCache.second.distances.end())
-      {
-        Distance distance = distanceIt->second + arpCache.second.responseTime;
-        ipDistance.push_back(make_pair(arpCache.first, distance));
-        if (maxDistance < distance.delay) maxDistance = distance.delay;
-      }
+      if (rRoute.area == mArea) continue;
+      addRoute(rRoutes, rRoute.area, distance + rRoute.cost, rRoute.via,
+               rRoute.hops);
     }
-    if (ipDistance.empty())
+  }
+}
+
+void NetworkLayer::sendSummaries()
+{
+  bool border = false;
+  for (auto& arpCache : mArpCache)
+  {
+    if (areaOf(arpCache.first) != mArea) border = true;
+  }
+  if (!border) return;
+  map<unsigned, AreaRoute> routes;
+  vector<Byte> packet;
+  summarize(routes, false);
+  buildSummary(routes, mArea, packet);
+  for (auto ip : spanningTree())
+  {
+    auto it = mArpCache.find(ip);
+    if (it != mArpCache.end()
+        && toLinkLayer(it->second.pLinkLayer, it->second.macAddress,
+                       &packet[0], packet.size(), true))
     {
-      info("Atrodo, nebėra kelio į adresato mazgą, paketas neišsiųstas.\n");
-      return false;
+      info("Išsiųsta santrauka į %x.\n", ip);
     }
-    if (maxDistance == 0)
+    else info("Nepavyko išsiųsti santraukos į %x.\n", ip);
+  }
+  summarize(routes, true);
+  for (auto& arpCache : mArpCache)
+  {
+    unsigned area = areaOf(arpCache.first);
+    if (area == mArea) continue;
+    buildSummary(routes, area, packet);
+    if (toLinkLayer(arpCache.second.pLinkLayer, arpCache.second.macAddress,
+                    &packet[0], packet.size(), true))
     {
-      info("Klaida: didžiausias atstumas yra 0.\n");
-      return false;
+      info("Išsiųsta santrauka kitos srities kaimynui %x.\n", arpCache.first);
+    }
+    else
+    {
+      info("Nepavyko išsiųsti santraukos kitos srities kaimynui %x.\n",
+           arpCache.first);
+    }
+  }
+}
+
+void NetworkLayer::buildSummary(const map<unsigned, AreaRoute>& rRoutes,
+                                unsigned except, vector<Byte>& rPacket)
+{
+  unsigned entries = 0;
+  for (auto& rRoute : rRoutes)
+  {
+    if (rRoute.second.area != except && rRoute.second.via != except) ++entries;
+  }
+  rPacket.resize(sizeof(Header) + LS_PREFIX_LENGTH
+                 + SUMMARY_ENTRY_LENGTH * entries);
+  Header header;
+  header.protocol    = LS_PROTOCOL;
+  header.ttl         = BROADCAST_TTL;
+  header.id          = ++mLastBroadcastId;
+  header.length      = rPacket.size() - sizeof(Header);
+  header.offset      = 0;
+  header.source      = mpNode->ipAddress();
+  header.destination = BROADCAST_IP;
+  header.toBytes(&rPacket[0]);
+  Byte* pData = &rPacket[sizeof(Header)];
+  unsigned sequence = ++mSequence;
+  int_to_bytes(pData, sequence);
+  short_to_bytes(pData + LS_AGE, 0);
+  pData[LS_KIND] = LS_SUMMARY;
+  int_to_bytes(pData + LS_BASE, sequence);
+  Byte* pEntry = pData + LS_PREFIX_LENGTH;
+  for (auto& rRoute : rRoutes)
+  {
+    if (rRoute.second.area == except || rRoute.second.via == except) continue;
+    int_to_bytes(pEntry, rRoute.second.area);
+    int_to_bytes(pEntry + 4, rRoute.second.cost);
+    int_to_bytes(pEntry + 8, rRoute.second.via);
+    pEntry[12] = rRoute.second.hops;
+    pEntry += SUMMARY_ENTRY_LENGTH;
+  }
+}
+
+bool NetworkLayer::updateSummary(IpAddress source, Byte* data, int length)
+{
+  if (length < LS_PREFIX_LENGTH
+      || (length - LS_PREFIX_LENGTH) % SUMMARY_ENTRY_LENGTH != 0
+      || bytes_to_short(data + LS_AGE) >= LS_MAX_AGE
+      || source == mpNode->ipAddress()
+      || (areaOf(source) != mArea && mArpCache.find(source) == mArpCache.end()))
+  {
+    return false;
+  }
+  auto it = mSummaries.find(source);
+  if (it != mSummaries.end()
+      && !newer_sequence(bytes_to_int(data), it->second.sequence))
+  {
+    return false;
+  }
+  Summary& rSummary = mSummaries[source];
+  rSummary.sequence = bytes_to_int(data);
+  clock_gettime(CLOCK_MONOTONIC, &rSummary.timeout);
+  add_milliseconds(rSummary.timeout,
+                   LS_TIMEOUT - 1000 * bytes_to_short(data + LS_AGE));
+  rSummary.routes.clear();
+  for (int i = LS_PREFIX_LENGTH; i < length; i += SUMMARY_ENTRY_LENGTH)
+  {
+    AreaRoute route = { bytes_to_int(data + i), bytes_to_int(data + i + 4),
+                        bytes_to_int(data + i + 8), data[i + 12] };
+    rSummary.routes.push_back(route);
+  }
+  mFibChanged = true;
+  return true;
+}
+
+unsigned NetworkLayer::fragmentLength(unsigned mtu, unsigned length)
+{
+  // RouteWorker::Distance saugo MTU FRAGMENT_CHUNK dalimis
+  static_assert(sizeof(Header) % FRAGMENT_CHUNK == 0
+                && MAX_MTU / FRAGMENT_CHUNK < 1U << (32 - DELAY_BITS),
+                "kelio MTU netelpa į RouteWorker::Distance");
+  unsigned maxLength = sizeof(Header) + (mtu - sizeof(Header)) / FRAGMENT_CHUNK
+                                        * FRAGMENT_CHUNK;
+  return min(maxLength, length);
+}
+
+bool NetworkLayer::route(Header& rHeader, PacketBuffer& rPacket)
+{
+  ArpCache* pNeighbour;
+  const NextHop* pHop = nextHop(rHeader.source, rHeader.destination,
+                                rHeader.id, &pNeighbour);
+  if (pHop == NULL) return false;
+  rHeader.ttl = pHop->ttl;
+  return send(*pHop, *pNeighbour, rHeader, rPacket);
+}
+
+bool NetworkLayer::forward(PacketBuffer& rPacket)
+{
+  Byte* packet = rPacket.data();
+  if (packet[HEADER_TTL] == 0)
+  {
+    info("Baigėsi paketo TTL, paketas išmestas.\n");
+    return false;
+  }
+  --packet[HEADER_TTL];
+  ArpCache* pNeighbour;
+  const NextHop* pHop = nextHop(bytes_to_int(packet + HEADER_SOURCE),
+                                bytes_to_int(packet + HEADER_DESTINATION),
+                                bytes_to_short(packet + HEADER_ID),
+                                &pNeighbour);
+  if (pHop == NULL) return false;
+  if (fragmentLength(pHop->mtu, rPacket.length()) == rPacket.length())
+  { // antraštė neperrašoma, perduodamas tas pats buferis
+    if (toLinkLayer(pNeighbour->pLinkLayer, pNeighbour->macAddress, rPacket))
+    {
+      return true;
+    }
+    info("Išsiųsti nepavyko.\n");
+    return false;
+  }
+  Header header(packet);
+  return send(*pHop, *pNeighbour, header, rPacket);
+}
+
+const NetworkLayer::NextHop* NetworkLayer::nextHop(IpAddress source,
+                                                   IpAddress destinationIp,
+                                                   unsigned short id,
+                                                   ArpCache** ppNeighbour)
+{
+  if (mFibChanged) submitRoutes(false);
+  const RouteTable* pRoutes = routes();
+  if (pRoutes == NULL)
+  {
+    info("Maršrutai dar neapskaičiuoti, paketas neišsiųstas.\n");
+    return NULL;
+  }
+  unsigned destination = pRoutes->find(destinationIp,
+                                       mDatabase.find(destinationIp));
+  const FibEntry* pEntry = NULL;
+  if (destination != NO_NODE && destination < pRoutes->fib.size()
+      && pRoutes->fib[destination].count > 0)
+  {
+    pEntry = &pRoutes->fib[destination];
+  }
+  else if (areaOf(destinationIp) != mArea)
+  { // ne kaimynas kitoje srityje
+    auto it = pRoutes->areaFib.find(areaOf(destinationIp));
+    if (it == pRoutes->areaFib.end())
+    {
+      info("Nerastas kelias į adresato sritį, paketas neišsiųstas.\n");
+      return NULL;
     }
-    for (auto& ipDist : ipDistance)
+    pEntry = &it->second;
+  }
+  else if (destination == NO_NODE || destination >= pRoutes->fib.size())
+  {
+    info("Nerastas kelias į adresato mazgą, paketas neišsiųstas.\n");
+    return NULL;
+  }
+  else
+  {
+    info("Atrodo, nebėra kelio į adresato mazgą, paketas neišsiųstas.\n");
+    return NULL;
+  }
+  const FibEntry& rEntry = *pEntry;
+  const vector<NextHop>& rNextHops = pRoutes->nextHops;
+  unsigned long long hash = flow_hash(((unsigned long long)source << 32)
+                                      | destinationIp,
+                                      ((unsigned long long)mpNode->ipAddress()
+                                       << 16) | id);
+  unsigned selected = (hash >> 32) % rEntry.count;
+  if ((hash & 0xffffffffULL) / 4294967296.0
+      >= rNextHops[rEntry.first + selected].probability)
+  {
+    selected = rNextHops[rEntry.first + selected].alias;
+  }
+  const NextHop* pSelected = &rNextHops[rEntry.first + selected];
+  auto it = mArpCache.find(pSelected->neighbour);
+  if (it == mArpCache.end())
+  { // lentelė sudaryta anksčiau, nei kaimynas išnyko
+    const NextHop* pBackup = &rNextHops[rEntry.first + pSelected->backup];
+    if (pBackup != pSelected) it = mArpCache.find(pBackup->neighbour);
+    if (it == mArpCache.end())
     {
-      totalWeight += ipDist.second.delay / double(maxDistance);
-      weights.push_back(totalWeight);
+      info("Kaimynas %x nebepasiekiamas, paketas neišsiųstas.\n",
+           pSelected->neighbour);
+      return NULL;
     }
+    info("Kaimynas %x nebepasiekiamas, siunčia atsarginiu %x.\n",
+         pSelected->neighbour, pBackup->neighbour);
+    pSelected = pBackup;
   }
+  else if (pSelected->ttl == 0) info("Siunčia tiesiogiai.\n");
   else
   {
-    info("Siunčia tiesiogiai.\n");
-    rHeader.ttl = 0;
+    info("Pasirinko %x (#%u iš %u galimų).\n", pSelected->neighbour, selected,
+         rEntry.count);
   }
+  *ppNeighbour = &it->second;
+  return pSelected;
+}
+
+bool NetworkLayer::send(const NextHop& rHop, ArpCache& rNeighbour,
+                        Header& rHeader, PacketBuffer& rPacket)
+{
+  Byte* packet = rPacket.data();
+  unsigned length = rPacket.length();
   do
   {
     info("offset = %hu\n", rHeader.offset);
-    unsigned currentLength = min(MAX_PACKET_SIZE, length);
+    unsigned currentLength = fragmentLength(rHop.mtu, length);
     rHeader.toBytes(packet);
-    if (it != mArpCache.end())
+    bool sent = currentLength == rPacket.length()
+                ? toLinkLayer(rNeighbour.pLinkLayer, // be kopijos
+                              rNeighbour.macAddress, rPacket)
+                : toLinkLayer(rNeighbour.pLinkLayer, rNeighbour.macAddress,
+                              packet, currentLength);
+    if (!sent)
     {
-      if (!it->second.pLinkLayer->fromNetworkLayer(it->second.macAddress,
-                                                   packet,
-                                                   currentLength))
-      {
-        info("Išsiųsti nepavyko.\n");
-        return false;
-      }
-    }
-    else
-    {
-      unsigned selected = lower_bound(weights.begin(), weights.end(),
-                                      totalWeight * (double(rand()) / RAND_MAX))
-                          - weights.begin();
-      if (selected >= ipDistance.size())
-      {
-        info("Klaida pasirenkant maršrutą.\n");
-        return false;
-      }
-      info("Pasirinko %x (#%u iš %u galimų).\n", ipDistance[selected].first,
-                                                 selected, weights.size());
-      rHeader.ttl = ipDistance[selected].second.hops * 3 / 2;
-      rHeader.toBytes(packet);
-      ArpCache& rArpCache = (mArpCache.find(ipDistance[selected].first))->second;
-      if (!rArpCache.pLinkLayer->fromNetworkLayer(rArpCache.macAddress,
-                                                  packet, length))
-      {
-        info("Išsiųsti nepavyko.\n");
-        return false;
-      }
+      info("Išsiųsti nepavyko.\n");
+      return false;
     }
     packet += currentLength - sizeof(Header);
     rHeader.offset += currentLength - sizeof(Header);
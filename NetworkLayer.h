@@ -1,24 +1,45 @@
 #ifndef NETWORKLAYER_H
 #define NETWORKLAYER_H
 #include <vector>
+#include <deque>
+#include <set>
+#include <map>
 #include <unordered_set>
 #include <unordered_map>
 #include "Layer.h"
-#include "Fragment.h"
+#include "MacSublayer.h"
+#include "PacketBuffer.h"
+#include "LinkCost.h"
+#include "RouteWorker.h"
+#include "Reassembly.h"
+#include "LinkStateDatabase.h"
 #include "hashes.h"
 
 #define ARP_PROTOCOL        0
-#define ARP_STARTED      5000
 #define ARP_PERIOD      20000
+#define ARP_JITTER         25 // procentais
 #define ARP_TIMEOUT    100000
 #define LS_PROTOCOL         1
 #define LS_PERIOD       20000
 #define LS_TIMEOUT     500000
+#define LS_REFRESH_PERIOD 200000 // pilno LS siuntimo periodas (< LS_TIMEOUT)
+#define LS_MIN_INTERVAL   100 // mažiausias laikas tarp sukeltų LS, ms
+#define LS_HYSTERESIS      20 // procentais
+#define LS_HYSTERESIS_MIN 100 // milisekundėmis
+#define LS_MAX_AGE (LS_TIMEOUT / 1000) // sekundėmis
+#define LS_SEQUENCE_RATE   16 // žr. „LS paketų numeriai“
 #define PACKET_TIMEOUT 500000
-#define MAX_PACKET_SIZE    99U
-#define CONSTANT_WEIGTH  1000
+#define MIN_MTU            99U // tiek turi priimti bet kuris kanalas
+#define MAX_MTU (MAX_DATA_LENGTH - 1U) // žr. LinkLayer::fromNetworkLayer
 #define TRANSPORT_PROTOCOL  2
 #define BROADCAST_TTL     255
+#define TIMER_TYPE_BITS     3
+#define MAX_PENDING_PACKETS 800 // tiek fragmentų turi didžiausias paketas
+#define SPF_DELAY          50 // žr. „Maršrutų skaičiavimo ribojimas“
+#define SPF_HOLD          200
+#define SPF_MAX_HOLD     5000
+#define AREA_PREFIX         0 // žr. „Sritys“; 0 – visas tinklas viena sritis
+#define AREA_MAX_HOPS      16 // per kiek daugiausiai sričių gali eiti kelias
 
 class Node;
 class LinkLayer;
@@ -39,23 +60,84 @@ class LinkLayer;
  * Jei nurodytas ARP protokolas, jo duomenis sudaro 1 ar daugiau baitų. Kai
  * mazgas gauna paketą su pirmu duomenų baitu lygiu 0, turi atgal siuntėjui
  * siųsti tokį patį paketą, tik pirmam baite įrašęs reikšmę 1. ARP paketams
- * TTL = 0.
- * Jei nurodytas LS protokolas, reiškia duomenis sudaro 4 baitų laiko žymė
- * (sekundės nuo UNIX eros pradžios) ir toliau einantys 8 baitų duomenų blokai:
- * 1–4 batai – tinklo adresas, 5–8 – delsa mikrosekundėmis kanale tarp paketo
- * siuntėjo ir mazgo su 1–4 baituose nurodytu tinklo adresu.
+ * TTL = 0. Paskutiniai 2 ARP duomenų baitai – kanalo MTU: užklausoje
+ * įrašomas siuntėjo, o atsakyme – mažesnysis iš jo ir atsakančiojo.
+ * Jei nurodytas LS protokolas, reiškia duomenis sudaro 4 baitų paketo numeris,
+ * 2 baitų amžius sekundėmis, 1 baitas – paketo rūšis (0 – pilnas,
+ * 1 – pokyčiai, 2 – sričių santrauka, žr. „Sritys“), 4 baitai – pilno
+ * paketo, kurio atžvilgiu nurodyti pokyčiai, numeris (pilname pakete – jo
+ * paties, o duomenų bazės mainų pakete – tas, kurio atžvilgiu bus siunčiami
+ * tolesni pokyčiai) ir toliau einantys 10 baitų duomenų blokai: 1–4 batai –
+ * tinklo adresas, 5–8 – delsa mikrosekundėmis kanale tarp paketo siuntėjo ir
+ * mazgo su 1–4 baituose nurodytu tinklo adresu, 9–10 – to kanalo MTU. Pilname
+ * pakete išvardijami visi kaimynai, pokyčių – tik pasikeitę nuo pilno paketo
+ * (išnykusio kaimyno delsa – 0xffffffff).
+ * Santraukoje vietoj jų – 13 baitų blokai: 1–4 baitai – srities numeris,
+ * 5–8 – atstumas iki jos, 9–12 – per kurią kaimyninę sritį einama,
+ * 13 – per kiek sričių einama.
  *
  * Tarnybinių paketų siuntimas tinklo grafo sudarymui.
  * Mazgas LS paketo formavimui laiko kaimynų delsos sąrašą. Kas ARP_PERIOD
  * milisekundžių BROADCAST_IP adresu visiems kaimynams išsiunčia ARP užklausą
  * su periodo pradžios laiko momento identifikatoriumi. Gavęs ARP atsakymus su
  * teisingu identifikatoriumi, išsisaugo jų siuntimo ir gavimo laiką.
+ * Kaimyno delsa (kanalo kaina) – ne paskutinio atsakymo laikas, o iš jų
+ * išlygintas ir kvantuotas įvertis (žr. LinkCost), todėl persiuntimo lentelė
+ * perskaičiuojama tik jam ar MTU pasikeitus.
  * Periodiškai kas LS_PERIOD milisekundžių kaimynai, iš kurių atsakymas gautas
- * seniau nei prieš ARP_TIMEOUT milisekundžių, ištrinami iš sąrašo, o iš likusių
- * suformuojamas LS paketas ir išsiunčiamas BROADCAST_IP adresu.
- * Periodinių ARP paketų siuntimas kiekvienu kanalu prasideda (ir vyksta)
- * skirtingu laiku. Pirmasis paketas išsiunčiamas praėjus atsitiktiniam
- * laikui iš intervalo [0; ARP_STARTED) milisekundėmis po laido prijungimo.
+ * seniau nei prieš ARP_TIMEOUT milisekundžių, ištrinami iš sąrašo, o likusieji
+ * palyginami su paskelbtaisiais. Kaimyno delsos pokytis laikomas reikšmingu,
+ * jei viršija LS_HYSTERESIS procentų paskelbtosios delsos ir
+ * LS_HYSTERESIS_MIN milisekundžių. Jei atsirado ar išnyko kaimynas, pasikeitė
+ * MTU ar reikšmingai delsa, BROADCAST_IP adresu išsiunčiamas pokyčių LS
+ * paketas su visais nuo paskutinio pilno paketo pasikeitusiais kaimynais
+ * (todėl pakanka gauti pilną ir paskutinį pokyčių paketą), o jei pokyčių nėra
+ * – nesiunčiama nieko. Kas LS_REFRESH_PERIOD milisekundžių, atsiradus
+ * kaimynui ir kai pokyčių daugiau nei kaimynų siunčiamas pilnas paketas su
+ * tikslia dabartine delsa.
+ * Kanaliniam lygiui pranešus, kad kaimynas nebeatsako (neighbourLost()), jis
+ * iškart išmetamas iš sąrašo, o LS siunčiamas nelaukiant periodo pabaigos,
+ * bet ne anksčiau nei po LS_MIN_INTERVAL milisekundžių nuo ankstesnio (kad
+ * numeriai neaplenktų laikrodžio, žr. „LS paketų numeriai“).
+ * Pokyčių paketas, kurio pilno paketo gavėjas neturi, atmetamas.
+ * Pirmoji ARP užklausa išsiunčiama iškart prijungus laidą, o tolesnės – kas
+ * ARP_PERIOD milisekundžių, iki ARP_JITTER procentų sutrumpinus atsitiktinai,
+ * kad abiejų laido galų užklausos nuolat nesusidurtų. Gavęs visiems skirtą
+ * ARP užklausą iš nežinomo kaimyno, mazgas be atsakymo išsiunčia ir savo
+ * užklausą jam tiesiogiai (jo MAC ir tinklo adresu; kanaliniame lygyje tokia
+ * nepasimeta), todėl gretimybė susidaro abiem kryptimis, net jei pirmoji jo
+ * užklausa dingo. Į tiesioginę užklausą tik atsakoma.
+ *
+ * Duomenų bazės mainai.
+ * Atsiradus naujam kaimynui (gavus pirmą jo ARP atsakymą), LS siunčiamas
+ * nelaukiant periodo pabaigos (kaip ir kaimynui prapuolus), o po savo LS
+ * paketo išsiuntimo naujam tos pačios srities kaimynui tiesiogiai (jo adresu,
+ * TTL = 0) išsiunčiama visa duomenų bazė: kiekvienam galiojančius duomenis
+ * turinčiam mazgui (išskyrus patį kaimyną) – pilnas LS paketas su turimu
+ * numeriu, pokyčių pagrindo numeriu ir amžiumi, atitinkančiu likusį
+ * galiojimo laiką. Gavėjas tokį paketą priima kaip įprastą, o jei jis
+ * naujesnis už turimą, persiunčia visiems skirtu (jungiamuoju medžiu, išskyrus
+ * siuntėją), kad sujungus du tinklus kiekvieno duomenys pasiektų kitą.
+ * Taigi naujai prijungtas mazgas maršrutus žino po kelių kadrų apsikeitimo,
+ * o ne po ARP ir LS periodų.
+ * Kadangi valdymo kadrų eilė riboto ilgio, bazė siunčiama dalimis: kiekvienam
+ * kaimynui laikoma žymė (mDatabaseCursors) – mazgas, kurio įrašas dar
+ * neperduotas kanaliniam lygiui. Eilei prisipildžius siuntimas sustoja ir
+ * tęsiamas nuo žymės, kai kanalinis lygis praneša apie atsiradusią vietą
+ * (linkReady()), arba kito LS periodo pradžioje. Kaimynas pamirštamas tik
+ * perdavus visus įrašus arba jam prapuolus.
+ *
+ * LS paketų numeriai.
+ * Kiekvienas mazgo siunčiamas LS paketas gauna vienetu didesnį 32 bitų
+ * numerį; numeriai lyginami ratu (a naujesnis už b, jei a - b, paverstas
+ * skaičiumi su ženklu, teigiamas), todėl persipildymas netrukdo. Priimamas
+ * tik naujesnis nei turimas paketas, taigi ir keli pakeitimai per sekundę.
+ * Paleistas mazgas numeravimą pradeda nuo sieninio laikrodžio laiko
+ * LS_SEQUENCE_RATE-osiomis sekundės dalimis, todėl (jei LS siunčiama rečiau)
+ * naujo paleidimo paketai naujesni už prieš tai išsiųstus. Amžių siuntėjas
+ * nustato lygų 0, o kiekvienas persiuntęs mazgas padidina vienetu; gavėjo
+ * duomenys galioja LS_TIMEOUT minus amžius, o ne jaunesni nei LS_MAX_AGE
+ * paketai atmetami, taigi užsilikusios senos kopijos nepratęsia duomenų.
  *
  * Maršrutizavimas.
  * Pagal naujausius iš kiekvieno mazgo, bet ne senesnius nei LS_TIMEOUT
@@ -70,62 +152,179 @@ class LinkLayer;
  * atstumas nuo i-ojo iš šių kaimynų iki X + atstumas iki šio kaimyno.
  * Tegu a_i = max(d_1, d_2, ..., d_N) / d_i. Tada tikimybė, kad siuntimui į X
  * bus pasirinktas kaimynas i lygi a_i / (a_1 + a_2 + ... + a_N).
+ * Šios tikimybės ir TTL kiekvienam adresatui iš anksto surašomos į
+ * persiuntimo lentelę (RouteWorker::Table::fib, indeksas – mazgo numeris)
+ * kaip Walkerio „alias“ lentelė, todėl siunčiant kaimynas parenkamas per
+ * O(1). Lentelė perskaičiuojama, jei nuo praeito karto keitėsi atstumai,
+ * kaimynai ar jų kainos.
+ * Kiekvienam lentelės kaimynui iš anksto parenkamas ir atsarginis
+ * (NextHop::backup) – artimiausias kitas to paties adresato kaimynas,
+ * pirmiausia – kitu kanalu. Atsarginiu gali būti tik kaimynas N, tenkinantis
+ * LFA (loop-free alternate) sąlygą D(N,D) < D(N,S) + D(S,D), kur D – adresatas,
+ * o S – šis mazgas: tada N trumpiausias kelias į D neina per S. Jei tokio
+ * kaimyno nėra, atsarginio nėra. D(N,D) imamas iš N atstumų lentelės (kelias,
+ * neinantis per kitus kaimynus, tik ilgesnis už tikrąjį, todėl sąlyga tik
+ * griežtesnė). Tikri atstumai D(S,N) ir D(N,S) randami mažame kaimynų ir šio
+ * mazgo grafe, kurio briaunos – atstumai tarp jų iš kaimynų lentelių (jose
+ * kiti kaimynai ir šis mazgas yra kelio galai), o D(S,D) – mažiausia
+ * D(S,N) + D(N,D). Kol kaimyno LS paketo nėra, D(N,S) laikoma kanalo kaina.
+ * Kaimyninio mazgo adresatui (siunčiama tiesiogiai) atsarginis parenkamas
+ * taip pat. Nutrūkus kanalui (removeLink) ar pasibaigus kaimyno ARP įrašui,
+ * jis iškart išmetamas iš mArpCache, ir kol paskelbiama nauja lentelė, jam
+ * skirti paketai siunčiami atsarginiu kaimynu.
+ * Vietoj atsitiktinio skaičiaus naudojama paketo (siuntėjas, gavėjas, ID) ir
+ * šio mazgo adreso maiša, todėl visi vieno paketo fragmentai (ir persiunčiant
+ * toliau) eina tuo pačiu keliu ir neišsirikiuoja, o skirtingi paketai vis tiek
+ * pasiskirsto pagal tikimybes. Mazgo adresas maišoje neleidžia visiems
+ * mazgams rinktis vienodai pagal tą pačią maišos reikšmę.
  * Išimtis – siuntimas BROADCAST_IP adresu.
  * Gavus paketą, adresuotą BROADCAST_IP adresu, sudaromas minimalus jungiamasis
  * medis naudojant Kruskalo algoritmą (arba naudojamas anksčiau sudarytas, jei
  * grafas nepakito). Svarbu, jog gavus LS paketą pirmiau būtų perskaičiuojami
- * atstumai, ir tik po to formuojamas jungiamasis medis. Šis paketas, nepakeitus
+ * atstumai, ir tik po to formuojamas jungiamasis medis. Briaunos laikomos
+ * surikiuotos pagal (svoris, siuntėjo IP, gavėjo IP) – visuose mazguose
+ * vienodai, kad medis sutaptų – ir keičiamos tik pasikeitusio mazgo
+ * briaunos. Atsiradus ar sutrumpėjus ne medžio briaunai, medžio kelyje tarp
+ * jos galų randama sunkiausia briauna ir pakeičiama nauja, jei ši lengvesnė
+ * (jei galai nesujungti – nauja tiesiog pridedama); sutrumpėjusi medžio
+ * briauna medyje lieka. Visas medis perskaičiuojamas (vienu praėjimu su
+ * DisjointSets) tik išnykus ar pailgėjus medžio briaunai. Kadangi briaunų
+ * tvarka griežta, abiem būdais gaunamas tas pats medis. Šis paketas, nepakeitus
  * gavėjo adreso, persiunčiamas visiems kaimynams, su kuriais yra jungiamojo
  * medžio briauna, išskyrus tą, nuo kurio paketas buvo gautas. Be to, jeigu
  * paketas nėra tarnybinio protokolo, jis perduodamas transporto lygiui.
  * Atstumų perskaičiavimas.
- * Pakitus briaunos svoriui iš X į Y (jei briauna susikuria, laikykime, kad
- * X lygus begalybei, o jei briauna išnyksta, kad Y lygus begalybei) Dijkstros
- * algoritmu atstumus reikės perskaičiuoti tik iki tų mazgų, iki kurių atstumas
- * buvo didesnis už min(X, Y).
+ * Ankstesnis kelio mazgas nesaugomas: atstumą iki V pagrindžia kiekviena
+ * briauna W–V, kuriai atstumas iki W plius briauna lygu atstumui iki V (ir
+ * MTU sutampa). Gavus mazgo U LS paketą (ar U duomenims pasenus) palyginami
+ * seni ir nauji U kaimynai. Jei briauna U–V pailgėjo, išnyko ar pakeitė MTU,
+ * o V atstumą pagrindė ji, tikrinama, ar V dar pagrindžia kita briauna. Jei
+ * ne, V atstumas pašalinamas, o tikrinami tie V kaimynai, kuriuos pagrindė
+ * V (senu atstumu; jei V – pasikeitęs mazgas, ir senomis briaunomis). Kadangi
+ * kiekviena briauna prideda bent CONSTANT_WEIGTH, pagrindimas nesudaro ciklų,
+ * tad pašalinami tiksliai tie mazgai, kurių visi trumpiausi keliai ėjo per
+ * pakitusias briaunas. Jų atstumai Dijkstros algoritmu skaičiuojami iš
+ * naujo, pradedant nuo atstumų iki jų nepaliestų kaimynų (tam laikomos ir
+ * atvirkštinės briaunos). Jei briauna U–V sutrumpėjo ar atsirado, Dijkstros
+ * algoritmas paleidžiamas tik nuo V ir eina tik per mazgus, iki kurių atstumas
+ * sumažėjo. Pasikeitus keliems mazgams, pirmiau pašalinami visų jų
+ * pailgėjusių briaunų nebepagrįsti atstumai, o tada vienu Dijkstros algoritmo
+ * paleidimu skaičiuojami jie ir atstumai per visas sutrumpėjusias briaunas.
+ * Visi atstumai skaičiuojami iš naujo tik pasikeitus kaimynų aibei.
+ * Grafas laikomas LinkStateDatabase, atstumų lentelės – masyvai, indeksuojami
+ * tankiais mazgų numeriais, o Dijkstros algoritmo eilė – IndexedHeap, todėl
+ * skaičiuojant nereikia ieškoti maišos lentelėse (greičio palyginimas su
+ * ankstesniu būdu – spfbench.cpp). Lentelės įrašas užima 4 baitus (žr.
+ * RouteWorker::Distance), todėl lentelės apie dvylika kartų mažesnės už
+ * maišos lenteles (distbench.cpp).
+ *
+ * Maršrutų skaičiavimo ribojimas.
+ * Gautas LS paketas iškart įrašomas į duomenų bazę, tačiau atstumai ir
+ * jungiamasis medis perskaičiuojami vėliau, kartu visiems per tą laiką
+ * pasikeitusiems mazgams (žr. „Atstumų perskaičiavimas“). Po ramybės
+ * laikotarpio skaičiuojama praėjus SPF_DELAY milisekundžių nuo pirmo
+ * pasikeitimo. Jei pasikeitimų būna dažniau, tarp skaičiavimų laukiama bent
+ * SPF_HOLD milisekundžių ir šis laikas kaskart dvigubinamas iki SPF_MAX_HOLD;
+ * jei per SPF_MAX_HOLD pasikeitimų nebuvo, laukimas vėl sutrumpinamas. Taigi po
+ * ryšio sutrikimo iš daugelio mazgų gauti LS paketai apdorojami vienu
+ * skaičiavimu, o maršrutai atnaujinami ne vėliau nei po SPF_MAX_HOLD. Visos
+ * trys reikšmės nustatomos paleidžiant mazgą (žr. Config.h). Pats skaičiavimas
+ * (atstumai, jungiamasis medis ir persiuntimo lentelė) vyksta RouteWorker
+ * gijoje su duomenų bazės kopija, todėl tuo metu mazgas toliau skaito laidų
+ * įtampas ir siunčia paketus pagal ankstesnę lentelę. Nauja lentelė paimama be
+ * užrakto (žr. RouteWorker.h) prieš siunčiant paketą; kol pirmoji
+ * neapskaičiuota, konkrečiam mazgui nesiunčiama.
+ *
+ * Sritys.
+ * Mazgo sritis – pirmieji jo adreso bitai (jų kiekis nustatomas paleidžiant,
+ * numatyta AREA_PREFIX; visuose mazguose turi būti vienodas). LS paketuose
+ * skelbiami tik tos pačios srities kaimynai, o kitos srities mazgų LS paketai
+ * atmetami ir nepersiunčiami, taigi duomenų bazėje ir atstumų lentelėse yra
+ * tik savos srities mazgai, o jungiamasis medis (ir siuntimas BROADCAST_IP
+ * adresu) neišeina už srities ribų.
+ * Mazgas, turintis kitos srities kaimynų, yra pasienio mazgas. Kartu su LS jis
+ * siunčia sričių santrauką: kiek kainuoja pasiekti kiekvieną žinomą sritį.
+ * Į savo sritį (jungiamuoju medžiu) siunčiami tik keliai per paties mazgo
+ * kitos srities kaimynus (iki kaimyno srities ir pagal kaimyno santrauką),
+ * o kiekvienam kitos srities kaimynui tiesiogiai – ir keliai per kitus savo
+ * srities pasienio mazgus, išskyrus einančius per kaimyno sritį (skaldomas
+ * horizontas). Kelias, einantis per AREA_MAX_HOPS sričių, nebeskelbiamas,
+ * todėl klaidingi keliai ratu išnyksta. Santraukos galioja kaip LS paketai.
+ * Kitos srities adresatui kaimynas parenkamas kaip ir savos srities, tik
+ * d_i – mažiausias atstumas per i-ąjį kaimyną iki pasienio mazgo (ar
+ * kitos srities kaimyno) ir toliau pagal jo santrauką. Taigi mazgas žino tik
+ * savo srities topologiją ir po vieną atstumą kiekvienai pasienio mazgo
+ * skelbiamai sričiai.
+ *
+ * Tranzitas.
+ * Gautas paketas, kuris nėra ARP ar LS ir skirtas ne šiam mazgui (ir ne
+ * BROADCAST_IP), persiunčiamas iškart, neperduodant jo visam paketų
+ * apdorojimui ir neišskaidant antraštės: perskaitomi tik siuntėjo, gavėjo ir
+ * ID laukai (kelio parinkimui), TTL sumažinamas vienetu pačiame buferyje (jei
+ * jis jau 0, paketas išmetamas), ir tas pats buferis perduodamas kanaliniam
+ * lygiui. Tik jei paketas netelpa į parinkto kelio MTU, jis skaidomas
+ * fragmentais kaip siunčiant.
  *
  * Persipildymo valdymas.
  * Apkrova paskirstoma tolygiai pagal pralaidumą.
  * Siunčiant paketą žingsnių skaitliukui suteikiama pradinė reikšmė nedidesnė,
  * nei pusantro karto tiek, koks atstumas turėtų būti pagal siunčiančiojo
  * mazgo numatymą.
- * ARP paketai kanaliniame lygyje su visais laukia bendroje eilėje, todėl
- * laukimas yra įtraukiamas skaičiuojant briaunos svorį.
+ * ARP ir LS paketai kanaliniame lygyje aplenkia duomenis (žr. LinkLayer.h),
+ * todėl pilnos duomenų eilės neatmeta tarnybinių paketų ir maršrutai
+ * neišnyksta esant didelei apkrovai. ARP laukimas įtraukiamas skaičiuojant
+ * briaunos svorį, tačiau apima tik eilės priekyje esantį kadrą ir kitus
+ * tarnybinius paketus.
+ * Jei kanalinio lygio duomenų eilė kaimynui pilna, paketai (fragmentai)
+ * nebeatmetami, o laikomi to kaimyno laukiančiųjų eilėje (ne daugiau nei
+ * nustatyta, numatyta MAX_PENDING_PACKETS). Kol ji netuščia, nauji paketai
+ * dedami į jos galą, kad nebūtų sumaišyta tvarka. Kanaliniam lygiui pranešus,
+ * kad atsirado vietos (linkReady()), eilė kiek įmanoma ištuštinama.
  *
  * Fragmentavimas.
  * Didžiausias paketo ilgis – 2^16 - 1. Jis siunčiamas ne didesniais, nei
- * MAX_PACKET_SIZE fragmentais. Siunčiant fragmentą, lauke offset nurodoma,
+ * kelio MTU fragmentais. Kelio MTU – mažiausias kelio kanalų MTU (kanalo MTU
+ * sužinomas iš ARP ir platinamas LS paketuose); jis skaičiuojamas kartu su
+ * atstumais ir įrašomas į persiuntimo lentelę kiekvienam kaimynui atskirai.
+ * Jei persiunčiamas paketas netelpa į toliau esantį kanalą, jis dar kartą
+ * suskaidomas. Visiems siunčiami paketai skaidomi MIN_MTU fragmentais, nes
+ * tarpiniai mazgai jų neskaido. Siunčiant fragmentą, lauke offset nurodoma,
  * kelintu baitu nuo paketo pradžios prasideda šio fragmento duomenys.
  * Fragmentų priklausymas tam pačiam paketui nustatomas pagal ID lauką. Jei po
  * paskutinio tam tikram paketui gauto fragmento praėjo
- * PACKET_TIMEOUT milisekundžių, paketas išmetamas.
+ * PACKET_TIMEOUT milisekundžių, paketas išmetamas. Fragmento duomenų pradžia
+ * ir ilgis (išskyrus paskutinį) – FRAGMENT_CHUNK kartotiniai, todėl
+ * gautos dalys žymimos bitų masyvu. Visi surenkami paketai kartu užima ne
+ * daugiau nei nustatyta atminties (numatyta MAX_REASSEMBLY_MEMORY); kai
+ * jos trūksta, išmetami seniausiai fragmentą gavę paketai (žr. Reassembly.h).
  */
 class NetworkLayer: public Layer
 {
   private:
-    enum class TimerType: unsigned char { SEND_ARP, SEND_LS };
-
-    struct Distance
-    {
-      unsigned long long delay;
-      unsigned           hops;
+    /**
+     * Laikmačio tipas saugomas žemiausiuose TIMER_TYPE_BITS identifikatoriaus
+     * bituose, likusiuose – tipui reikalingi duomenys (pvz., SEND_ARP –
+     * kanalinio lygio adresas).
+     */
+    enum class TimerType: unsigned char { SEND_ARP, SEND_LS, UPDATE_ROUTES };
 
-      bool operator < (const Distance& other) const
-      {
-        return delay < other.delay;
-      }
+    typedef RouteWorker::Distance         Distance;
+    typedef RouteWorker::DistanceTable    DistanceTable;
+    typedef RouteWorker::NextHop          NextHop;
+    typedef RouteWorker::FibEntry         FibEntry;
+    typedef RouteWorker::AreaRoute        AreaRoute;
+    typedef RouteWorker::Table            RouteTable;
+    typedef LinkStateDatabase::Edge       Edge;
+    typedef LinkStateDatabase::EdgeList   EdgeList;
+    typedef deque<PacketBuffer>           PacketQueue;
 
-      Distance operator + (unsigned additionalDelay) const
-      {
-        Distance result;
-        result.delay = delay + additionalDelay + CONSTANT_WEIGTH;
-        result.hops = hops + 1;
-        return result;
-      }
+    struct Link
+    {
+      TimerHandle                             arpTimer;
+      unordered_map<MacAddress, PacketQueue>  pending; // laukia vietos
+                                                       // kanalinio lygio eilėje
     };
 
-    typedef unordered_map<IpAddress, Distance> DistanceMap;
-
     struct Header
     {
       unsigned char  protocol;
@@ -158,89 +357,277 @@ class NetworkLayer: public Layer
         int_to_bytes(bytes + 8,  source);
         int_to_bytes(bytes + 12, destination);
       }
+
+      /**
+       * @return ar tai tinklo valdymo paketas, kurį kanalinis lygis siunčia
+       *         pirmiau už duomenis
+       */
+      bool isControl() const
+      {
+        return protocol == ARP_PROTOCOL || protocol == LS_PROTOCOL;
+      }
     };
 
     struct ArpCache
     {
-      MacAddress  macAddress;
-      unsigned    responseTime;
-      timespec    timeout;
-      LinkLayer*  pLinkLayer;
-      DistanceMap distances;
+      MacAddress    macAddress;
+      unsigned      responseTime; // kanalo kaina (cost.cost())
+      LinkCost      cost;
+      timespec      timeout;
+      LinkLayer*    pLinkLayer;
+      unsigned      mtu;
 
-      void update(MacAddress m, timespec& r, timespec& t, LinkLayer* p)
+      ArpCache(): responseTime(0), mtu(0) { }
+
+      /**
+       * @return ar pasikeitė kanalo kaina ar MTU
+       */
+      bool update(MacAddress m, timespec& r, timespec& t, LinkLayer* p,
+                  unsigned u)
       {
         macAddress = m;
-        responseTime = r.tv_sec * 1000 + (r.tv_nsec + (MILLION / 2)) / MILLION;
+        bool changed = cost.add(r.tv_sec * 1000
+                                + (r.tv_nsec + (MILLION / 2)) / MILLION);
+        responseTime = cost.cost();
         timeout = t;
         add_milliseconds(timeout, ARP_TIMEOUT);
         pLinkLayer = p;
+        changed |= mtu != u;
+        mtu = u;
+        return changed;
       }
     };
 
-    struct NodeInfo
+    struct Adjacency
     {
-      unsigned                           syn;        // LS paketo laikas
-      timespec                           timeout;    // duomenų galiojimo laikas
-      vector<pair<IpAddress, unsigned> > neighbours; // kaimynų IP, atstumai
-      unsigned                           kruskalSet; // Kruskalo algoritmui
-      unsigned                           lastId;     // siųsto paketo ID
-
-      NodeInfo():
-        syn(0),
-        kruskalSet(BROADCAST_IP)
-      {
-        timeout.tv_sec = 0;
-        timeout.tv_nsec = 0;
-      }
+      unsigned      delay;
+      unsigned      mtu;
+    };
 
-      bool update(Byte* data, int length)
-      {
-        if (length < 12 || (length - 4) % 8 != 0 || bytes_to_int(data) <= syn)
-        {
-          return false;
-        }
-        clock_gettime(CLOCK_MONOTONIC, &timeout);
-        add_milliseconds(timeout, LS_TIMEOUT);
-        neighbours.clear();
-        for (int i = 4; i < length; i += 8)
-        {
-          neighbours.push_back(make_pair(bytes_to_int(data + i),
-                                         bytes_to_int(data + i + 4)));
-        }
-        return true;
-      }
+    struct Summary
+    {
+      unsigned          sequence;
+      timespec          timeout;
+      vector<AreaRoute> routes;
     };
 
   private:
-    unordered_set<LinkLayer*>                                 mLinks;
-    long long                                                 mLastTimerId;
-    unordered_map<long long, pair<TimerType, LinkLayer*> >    mTimers;
+    unordered_map<LinkLayer*, Link>                           mLinks;
     unordered_map<IpAddress, ArpCache>                        mArpCache;
-    unordered_set<IpAddress>                                  mSpanningTree;
-    unordered_map<IpAddress, NodeInfo>                        mNodes;
+    LinkStateDatabase                                         mDatabase;
+    unsigned                                                  mSelf;
+    RouteWorker                                               mRouteWorker;
+    RouteTable*                                               mpRoutes; // iš
+                                                   // mRouteWorker paimta
     unsigned                                                  mLastBroadcastId;
-    unordered_map<pair<IpAddress, unsigned short>, Fragment*> mFragments;
+    unordered_map<IpAddress, Adjacency>                       mAdvertised;
+    unordered_set<IpAddress>                                  mTouched; // po
+                                                         // pilno LS pakitę
+    unsigned                                                  mSequence;
+    unsigned                                                  mBaseSequence;
+    timespec                                                  mNextFullLs;
+    bool                                                      mFibChanged;
+    unordered_map<unsigned, EdgeList>                         mChanges; // mazgas
+                                              // – briaunos prieš pasikeitimą
+    TimerHandle                                               mUpdateTimer;
+    TimerHandle                                               mLsTimer;
+    timespec                                                  mLastLs; // kada
+                                                     // vykdytas SEND_LS
+    timespec                                                  mLastUpdate;
+    int                                                       mHold; // ms
+    Reassembly                                                mReassembly;
+    unsigned                                                  mArea;
+    unordered_map<IpAddress, Summary>                         mSummaries; // iš
+                                                       // pasienio mazgų
+    unsigned                                                  mLastAreaId; // ID
+                                         // siųsto kitų sričių adresatams
+    unordered_set<IpAddress>                                  mNewNeighbours;
+                                         // bazė siunčiama po savo LS
+    unordered_map<IpAddress, unsigned>                        mDatabaseCursors;
+                                         // kaimynas -> kitas siųstinas mazgas
 
   public:
     NetworkLayer(Node* pNode);
+    ~NetworkLayer();
     void timer(long long id); // žr. Layer.h
     void addLink(LinkLayer* pLinkLayer);
     void removeLink(LinkLayer* pLinkLayer);
-    void fromLinkLayer(LinkLayer* pLinkLayer, MacAddress source, Byte* packet,
-                       FrameLength packetLength);
-    bool fromTransportLayer(IpAddress destination, Byte* tpdu, unsigned length);
+    void fromLinkLayer(LinkLayer* pLinkLayer, MacAddress source,
+                       PacketBuffer& rPacket);
+
+    /**
+     * Išsiunčia segmentą. Antraštė įrašoma į rTpdu buferio priekį, o jei
+     * paketo skaidyti nereikia, pats buferis perduodamas kanaliniam lygiui.
+     */
+    bool fromTransportLayer(IpAddress destination, PacketBuffer& rTpdu);
+
+    /**
+     * Kanalinio lygio pranešimas, kad siuntimo į destination eilėje vėl yra
+     * vietos duomenims arba valdymo kadrams.
+     */
+    void linkReady(LinkLayer* pLinkLayer, MacAddress destination);
+
+    /**
+     * Kanalinio lygio pranešimas, kad kaimynas neighbour nebeatsako.
+     */
+    void neighbourLost(LinkLayer* pLinkLayer, MacAddress neighbour);
 
   protected:
     const char* layerName()
       { return "Tinklo lygis"; }
 
   private:
-    void     startTimer(int timeout, TimerType timerType, LinkLayer* pLinkLayer);
-    void     kruskal();
-    unsigned kruskalSetOf(IpAddress node);
-    void     dijkstras();
-    void     dijkstra(IpAddress root, DistanceMap& rDistances);
+    TimerHandle startTimer(int timeout, TimerType timerType,
+                           LinkLayer* pLinkLayer);
+
+    /**
+     * Išsiunčia ARP užklausą kanalu pLinkLayer (visiems – BROADCAST_MAC ir
+     * BROADCAST_IP adresais).
+     */
+    void sendArpRequest(LinkLayer* pLinkLayer, MacAddress macAddress,
+                        IpAddress destination);
+
+    /**
+     * Paankstina LS siuntimą (žr. „Tarnybinių paketų siuntimas“).
+     */
+    void triggerLinkState();
+
+    /**
+     * Siunčia naujam kaimynui LS duomenų bazę (žr. „Duomenų bazės mainai“)
+     * nuo mazgo rNext, kol pilna valdymo kadrų eilė. rNext nustatomas į
+     * mazgą, nuo kurio reikės tęsti. Grąžina true, jei visa bazė perduota
+     * kanaliniam lygiui arba kaimyno nebėra.
+     */
+    bool     sendDatabase(IpAddress neighbour, unsigned& rNext);
+
+    /**
+     * Persiunčia visiems skirtą paketą jungiamojo medžio kaimynams, išskyrus
+     * tą, kurio MAC adresas except.
+     */
+    void     flood(Byte* packet, unsigned length, MacAddress except,
+                   bool control);
+
+    /**
+     * Palygina kaimynus su paskelbtaisiais ir, jei reikia, suformuoja LS
+     * paketą (pilną arba pokyčių).
+     *
+     * @return false, jei siųsti nereikia
+     */
+    bool     buildLinkState(const timespec& rCurrent, vector<Byte>& rPacket);
+
+    /**
+     * Įrašo gautą LS paketą į duomenų bazę ir atnaujina atstumus.
+     *
+     * @return false, jei paketas blogas arba senesnis už turimus duomenis
+     */
+    bool     updateLinkState(IpAddress source, Byte* data, int length);
+
+    /**
+     * @return srities, kuriai priklauso address, numeris (žr. „Sritys“)
+     */
+    unsigned areaOf(IpAddress address);
+
+    /**
+     * Apskaičiuoja geriausius kelius į kitas sritis, kuriuos šis mazgas gali
+     * skelbti.
+     *
+     * @param allBorders ar įtraukti kelius per kitus savo srities pasienio
+     *                   mazgus (siunčiant kitai sričiai)
+     */
+    void     summarize(map<unsigned, AreaRoute>& rRoutes, bool allBorders);
+
+    /**
+     * Įrašo kelią į rRoutes, jei jis trumpesnis už turimą ir neviršija
+     * AREA_MAX_HOPS.
+     */
+    static void addRoute(map<unsigned, AreaRoute>& rRoutes, unsigned area,
+                         unsigned long long cost, unsigned via, unsigned hops);
+
+    /**
+     * Jei šis mazgas pasienio, išsiunčia sričių santraukas.
+     */
+    void     sendSummaries();
+
+    /**
+     * Suformuoja santraukos paketą iš rRoutes, praleisdamas kelius į sritį
+     * except ir per ją.
+     */
+    void     buildSummary(const map<unsigned, AreaRoute>& rRoutes,
+                          unsigned except, vector<Byte>& rPacket);
+
+    /**
+     * Įrašo gautą sričių santrauką.
+     *
+     * @return false, jei paketas blogas arba senesnis už turimą
+     */
+    bool     updateSummary(IpAddress source, Byte* data, int length);
+
+    /**
+     * Perduoda paketą kanaliniam lygiui. Duomenų paketas, kuriam kanalinio
+     * lygio eilėje nėra vietos, padedamas į laukiančiųjų eilę. Perduoto ar
+     * padėto paketo buferis paimamas (rPacket lieka tuščias).
+     *
+     * @return true, jei paketas perduotas arba padėtas į eilę
+     */
+    bool     toLinkLayer(LinkLayer* pLinkLayer, MacAddress destination,
+                         PacketBuffer& rPacket, bool isControl = false);
+
+    /**
+     * Perduoda kanaliniam lygiui paketo kopiją (siunčiant keliems kaimynams).
+     */
+    bool     toLinkLayer(LinkLayer* pLinkLayer, MacAddress destination,
+                         const Byte* packet, unsigned length,
+                         bool isControl = false);
+
+    /**
+     * Ištrina mazgus, kurių LS duomenys paseno, ir atnaujina atstumus.
+     */
+    void     expireNodes();
+
+    /**
+     * Įsimena pasikeitusį mazgą ir, jei reikia, suplanuoja maršrutų
+     * perskaičiavimą (žr. „Maršrutų skaičiavimo ribojimas“).
+     *
+     * @param node  mazgas, kurio kaimynų sąrašas pakeistas (ar ištrintas)
+     * @param rOld  senas kaimynų sąrašas
+     */
+    void     linkStateChanged(unsigned node, const EdgeList& rOld);
+
+    /**
+     * Pateikia maršrutų skaičiavimą su visais įsimintais pasikeitimais.
+     */
+    void     updateRoutes();
+
+    /**
+     * Pateikia mRouteWorker užduotį pagal dabartinę duomenų bazę, kaimynus ir
+     * santraukas (iš duomenų bazės – tik pasikeitusių mazgų briaunos).
+     *
+     * @param withChanges ar perduoti (ir pamiršti) įsimintus pasikeitimus
+     */
+    void     submitRoutes(bool withChanges);
+
+    /**
+     * Paima naujausią paskelbtą persiuntimo lentelę, jei tokia yra.
+     *
+     * @return dabartinė lentelė arba NULL, jei dar nė viena neapskaičiuota
+     */
+    const RouteTable* routes();
+
+    /**
+     * @return kaimynai minimaliame jungiamajame medyje (siuntimui visiems)
+     */
+    const unordered_set<IpAddress>& spanningTree();
+
+    /**
+     * Atlaisvina mazgo numerį, jei jo nebereikia (žr. LinkStateDatabase).
+     * Šio mazgo ir kaimynų numeriai neatlaisvinami.
+     */
+    void     releaseIfUnused(unsigned node);
+
+    /**
+     * @return kiek paketo baitų (su antrašte) siųsti viename fragmente
+     */
+    static unsigned fragmentLength(unsigned mtu, unsigned length);
     
     /**
      * Parenka kelią ir išsiunčia paketą, skirtą konkrečiam mazgui.
@@ -248,12 +635,41 @@ class NetworkLayer: public Layer
      * pusantro karto daugiau, nei parinktas kelias. Kiti tarnybiniai laukai
      * jau turi būti nustatyti.
      *
+     * Jei paketas telpa į kelio MTU, kanaliniam lygiui perduodamas pats
+     * rPacket buferis, kitu atveju – kiekvienas fragmentas atskirai.
+     *
      * @param rHeader paketo antraštė
-     * @param packet  paketas
-     * @param length  paketo ilgis baitais
+     * @param rPacket paketas (su antrašte)
+     * @return true, jei pavyko išsiųsti; false priešingu atveju
+     */
+    bool route(Header& rHeader, PacketBuffer& rPacket);
+
+    /**
+     * Persiunčia kitam mazgui skirtą gautą paketą (žr. „Tranzitas“).
+     * Antraštė neišskaidoma: TTL sumažinamas pačiame pakete, o jei paketas
+     * telpa į kelio MTU, kanaliniam lygiui perduodamas gautas buferis.
+     *
      * @return true, jei pavyko išsiųsti; false priešingu atveju
      */
-    bool route(Header& rHeader, Byte* packet, unsigned length);
+    bool forward(PacketBuffer& rPacket);
+
+    /**
+     * Pagal persiuntimo lentelę parenka kaimyną, per kurį siųsti paketą
+     * (jei reikia, pateikia lentelės perskaičiavimą, bet jo nelaukia).
+     * Jei parinkto kaimyno nebėra mArpCache, imamas atsarginis.
+     *
+     * @param ppNeighbour čia įrašomas parinkto kaimyno mArpCache įrašas
+     * @return parinktas kelias arba NULL, jei kelio nėra
+     */
+    const NextHop* nextHop(IpAddress source, IpAddress destinationIp,
+                           unsigned short id, ArpCache** ppNeighbour);
+
+    /**
+     * Išsiunčia paketą (jei reikia – fragmentais) parinktu keliu per
+     * rNeighbour. Antraštė įrašoma iš rHeader.
+     */
+    bool send(const NextHop& rHop, ArpCache& rNeighbour, Header& rHeader,
+              PacketBuffer& rPacket);
 };
 
 #endif
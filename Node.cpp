@@ -1,6 +1,7 @@
 #include "Node.h"
 #include "LinkLayer.h"
 #include <cstdio>
+#include <cstring>
 #include <algorithm>
 #include <unistd.h>
 #include <sys/types.h>
@@ -8,8 +9,17 @@
 #include <poll.h>
 #include <arpa/inet.h> // inet_pton
 
+static timespec monotonic_time()
+{
+  timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return time;
+}
+
 Node::Node(int wireSocket, int appSocket, MacAddress macAddress,
-           IpAddress ipAddress):
+           IpAddress ipAddress, const Config& rConfig):
+  mStartTime(monotonic_time()), // prieš lygius, nes jie paleidžia laikmačius
+  mConfig(rConfig),
   mWireSocket(wireSocket),
   mAppSocket(appSocket),
   mMacAddress(macAddress),
@@ -46,12 +56,19 @@ void Node::layerMessage(const char* layerName, const char* format, va_list vl)
   fflush(stdout);
 }
 
-void Node::startTimer(Layer* layer, int milliseconds, long long id)
+TimerHandle Node::startTimer(Layer* layer, int milliseconds, long long id)
 {
-  timespec time;
-  clock_gettime(CLOCK_MONOTONIC, &time);
-  add_milliseconds(time, milliseconds);
-  mTimers.insert(make_pair(time, make_pair(layer, id)));
+  return mTimers.add(currentTick() + milliseconds, layer, id);
+}
+
+bool Node::cancelTimer(TimerHandle handle)
+{
+  return mTimers.cancel(handle);
+}
+
+bool Node::restartTimer(TimerHandle handle, int milliseconds)
+{
+  return mTimers.reschedule(handle, currentTick() + milliseconds);
 }
 
 IpAddress Node::ipAddress()
@@ -64,6 +81,11 @@ MacAddress Node::macAddress()
   return mMacAddress;
 }
 
+const Config& Node::config()
+{
+  return mConfig;
+}
+
 void Node::run()
 {
   while (1)
@@ -81,21 +103,14 @@ void Node::run()
     }
     fd_set tempFdSet = mFdSet;
     timespec timeout;
-    if (!mTimers.empty())
+    long long untilTimer = mTimers.untilNext(currentTick());
+    if (untilTimer >= 0)
     {
-      clock_gettime(CLOCK_MONOTONIC, &timeout);
-      if (timeout < mTimers.begin()->first)
-      {
-        timeout = mTimers.begin()->first - timeout;
-      }
-      else
-      {
-        timeout.tv_sec = 0;
-        timeout.tv_nsec = 0;
-      }
+      timeout.tv_sec = untilTimer / 1000;
+      timeout.tv_nsec = untilTimer % 1000 * MILLION;
     }
     if (pselect(moreThanMaxSocket, &tempFdSet, NULL, NULL,
-                (mTimers.empty() ? NULL : &timeout), NULL) < 0)
+                (untilTimer < 0 ? NULL : &timeout), NULL) < 0)
     {
       perror("select");
       break;
@@ -180,7 +195,8 @@ void Node::run()
       {
         IpAddress ip;
         ipStr[strlen(ipStr) - 1] = '\0'; // nuima \n
-        if (1 != inet_pton(AF_INET, ipStr, &ip))
+        if (0 == strcmp(ipStr, "stat")) printStatistics(stdout);
+        else if (1 != inet_pton(AF_INET, ipStr, &ip))
         {
           perror("Netaisyklingas IP adresas");
           printf("%s\n", ipStr);
@@ -188,24 +204,34 @@ void Node::run()
         else
         {
           printf("Siunčiama į tinklo lygį.\n");
-          Byte uninit[128];
-          mNetworkLayer.fromTransportLayer(ntohl(ip), uninit, 128);
+          PacketBuffer uninit(128);
+          mNetworkLayer.fromTransportLayer(ntohl(ip), uninit);
         }
       }
     }
 
-    while (!mTimers.empty())
+    Layer*    pLayer;
+    long long timerId;
+    while (mTimers.expire(currentTick(), pLayer, timerId))
+    {
+      pLayer->timer(timerId);
+    }
+
+    for (auto& rRemoved : mRemovedLinks)
     {
-      timespec current;
-      clock_gettime(CLOCK_MONOTONIC, &current);
-      if (current < mTimers.begin()->first) break;
-      pair<Layer*, long long> timer = mTimers.begin()->second;
-      mTimers.erase(mTimers.begin());
-      timer.first->timer(timer.second);
+      delete rRemoved.second;
+      delete rRemoved.first;
     }
+    mRemovedLinks.clear();
   }
 }
 
+void Node::printStatistics(FILE* pFile)
+{
+  for (auto& rLink : mMacToLink) rLink.second->printStatistics(pFile);
+  fflush(pFile);
+}
+
 bool Node::toPhysicalLayer(MacSublayer* pMacSublayer, char voltage)
 {
   //printf("Siunčia signalą %hhd\n", voltage);
@@ -241,14 +267,14 @@ bool Node::isWireIdle(MacSublayer* pMacSublayer)
 }
 
 void Node::toLinkLayer(MacSublayer* pMacSublayer, MacAddress source,
-                       Frame& rFrame)
+                       PacketBuffer& rFrame)
 {
   mMacToLink.find(pMacSublayer)->second->fromMacSublayer(source, rFrame);
 }
 
-void Node::toNetworkLayer(IpAddress destination, Byte* tpdu, unsigned length)
+void Node::toNetworkLayer(IpAddress destination, PacketBuffer& rTpdu)
 {
-  mNetworkLayer.fromTransportLayer(destination, tpdu, length);
+  mNetworkLayer.fromTransportLayer(destination, rTpdu);
 }
 
 void Node::toTransportLayer(IpAddress source, Byte* tpdu, unsigned length)
@@ -256,6 +282,12 @@ void Node::toTransportLayer(IpAddress source, Byte* tpdu, unsigned length)
   mTransportLayer.fromNetworkLayer(source, tpdu, length);
 }
 
+unsigned long long Node::currentTick()
+{
+  timespec current = monotonic_time() - mStartTime;
+  return current.tv_sec * 1000ULL + current.tv_nsec / MILLION;
+}
+
 void Node::removeApp(int appSocket)
 {
   printf("Atsijungė programa (%d).\n", appSocket);
@@ -278,8 +310,8 @@ void Node::removeLink(int wireSocket, MacSublayer* pMacSublayer)
     mNetworkLayer.removeLink(it->second);
     mMacSublayerToSocket.erase(pMacSublayer);
     mSocketToMacSublayer.erase(wireSocket);
-    pMacSublayer->selfDestruct();
-    it->second->selfDestruct();
+    // dar gali būti naudojami iškvietimų steke, todėl sunaikinami ciklo gale
+    mRemovedLinks.push_back(make_pair(pMacSublayer, it->second));
     mMacToLink.erase(it);
     FD_CLR(wireSocket,  &mFdSet);
   }
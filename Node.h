@@ -2,6 +2,7 @@
 #define NODE_H
 
 #include <cstdarg>
+#include <cstdio>
 #include <ctime>
 #include <vector>
 #include <set>
@@ -9,6 +10,8 @@
 #include <unordered_map>
 #include <sys/select.h>
 #include "types.h"
+#include "Config.h"
+#include "TimerWheel.h"
 #include "MacSublayer.h"
 #include "NetworkLayer.h"
 #include "TransportLayer.h"
@@ -18,7 +21,10 @@ class LinkLayer;
 class Node
 {
   private:
-    multimap<timespec, pair<Layer*, long long> > mTimers;
+    TimerWheel                                   mTimers;
+    timespec                                     mStartTime; // laikmačių
+                                                             // laiko pradžia
+    Config                                       mConfig;
     int                                          mWireSocket;
     int                                          mAppSocket;
     MacAddress                                   mMacAddress;
@@ -30,11 +36,13 @@ class Node
     set<int>                                     mAppSockets;
     unordered_map<int, int>                      mAppToSocket;
     unordered_map<MacSublayer*, LinkLayer*>      mMacToLink;
+    vector<pair<MacSublayer*, LinkLayer*> >      mRemovedLinks; // sunaikinami
+                                                                // ciklo gale
     fd_set                                       mFdSet;
 
   public:
     Node(int wireSocket, int appSocket, MacAddress macAddress,
-         IpAddress ipAddress);
+         IpAddress ipAddress, const Config& rConfig);
     ~Node();
 
     /**
@@ -54,11 +62,34 @@ class Node
      * @param layer        tinklo lygio esybė, kuriai taikomas laikmatis
      * @param milliseconds už kelių milisekundžių laikmatis turi baigtis
      * @param id           kokia reikšmė pasibaigus perduodama layer->timer
+     * @return laikmačio rankena atšaukimui ar perkėlimui
      */
-    void       startTimer(Layer* layer, int milliseconds, long long id);
+    TimerHandle startTimer(Layer* layer, int milliseconds, long long id);
+
+    /**
+     * Atšaukia laikmatį.
+     * Lygis, sunaikindamas objektą, kuriam skirti laikmačiai, privalo juos
+     * atšaukti.
+     *
+     * @param handle startTimer() grąžinta rankena (0 – jokio laikmačio)
+     * @return true, jei laikmatis dar nebuvo pasibaigęs
+     */
+    bool       cancelTimer(TimerHandle handle);
+
+    /**
+     * Perkelia dar nepasibaigusį laikmatį taip, kad baigtųsi praėjus
+     * milliseconds milisekundžių nuo dabar.
+     *
+     * @param handle       startTimer() grąžinta rankena
+     * @param milliseconds už kelių milisekundžių laikmatis turi baigtis
+     * @return true, jei pavyko; false, jei laikmatis jau pasibaigė arba buvo
+     *         atšauktas (tada reikia paleisti naują)
+     */
+    bool       restartTimer(TimerHandle handle, int milliseconds);
 
     IpAddress  ipAddress();
     MacAddress macAddress();
+    const Config& config();
 
     /**
      * Pradeda mazgo simuliacija.
@@ -66,6 +97,12 @@ class Node
      */
     void       run();
 
+    /**
+     * Išveda kiekvieno laido kanalinio lygio statistiką (žr. LinkStatistics.h).
+     * Iškviečiama į standartinį įvedimą įvedus „stat“.
+     */
+    void       printStatistics(FILE* pFile);
+
     /**
      * Signalo siuntimas į fizinį lygį.
      *
@@ -86,9 +123,12 @@ class Node
     bool isWireIdle(MacSublayer* pMacSublayer);
 
     void toLinkLayer(MacSublayer* pMacSublayer, MacAddress source,
-                     Frame& rFrame);
+                     PacketBuffer& rFrame);
 
-    void toNetworkLayer(IpAddress destination, Byte* tpdu, unsigned length);
+    /**
+     * Perduoda segmentą tinklo lygiui (žr. PacketBuffer.h).
+     */
+    void toNetworkLayer(IpAddress destination, PacketBuffer& rTpdu);
 
     void toTransportLayer(IpAddress source, Byte* tpdu, unsigned length);
 
@@ -100,6 +140,11 @@ class Node
     void removeApp(int appSocket);
 
   private:
+    /**
+     * @return kiek milisekundžių praėjo nuo mazgo sukūrimo
+     */
+    unsigned long long currentTick();
+
     /**
      * Atjungia nuo laido.
      *
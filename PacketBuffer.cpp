@@ -0,0 +1,78 @@
+#include "PacketBuffer.h"
+#include <cstring>
+#include <algorithm>
+
+PacketBuffer::PacketBuffer():
+  mpBuffer(NULL),
+  mCapacity(0),
+  mStart(0),
+  mLength(0)
+{ }
+
+PacketBuffer::PacketBuffer(unsigned length, unsigned headroom,
+                           unsigned tailroom):
+  mpBuffer(new Byte[headroom + length + tailroom]),
+  mCapacity(headroom + length + tailroom),
+  mStart(headroom),
+  mLength(length)
+{ }
+
+PacketBuffer::PacketBuffer(const Byte* data, unsigned length,
+                           unsigned headroom):
+  mpBuffer(new Byte[headroom + length]),
+  mCapacity(headroom + length),
+  mStart(headroom),
+  mLength(length)
+{
+  memcpy(mpBuffer + mStart, data, length);
+}
+
+PacketBuffer::~PacketBuffer()
+{
+  delete[] mpBuffer;
+}
+
+Byte* PacketBuffer::push(unsigned length)
+{
+  if (mStart < length) reallocate(length + PACKET_HEADROOM, tailroom());
+  mStart -= length;
+  mLength += length;
+  return data();
+}
+
+void PacketBuffer::pull(unsigned length)
+{
+  if (length > mLength) length = mLength;
+  mStart += length;
+  mLength -= length;
+}
+
+Byte* PacketBuffer::put(unsigned length)
+{
+  if (tailroom() < length) reallocate(mStart, length);
+  mLength += length;
+  return data() + mLength - length;
+}
+
+void PacketBuffer::trim(unsigned length)
+{
+  if (length < mLength) mLength = length;
+}
+
+void PacketBuffer::swap(PacketBuffer& rOther)
+{
+  std::swap(mpBuffer, rOther.mpBuffer);
+  std::swap(mCapacity, rOther.mCapacity);
+  std::swap(mStart, rOther.mStart);
+  std::swap(mLength, rOther.mLength);
+}
+
+void PacketBuffer::reallocate(unsigned headroom, unsigned tailroom)
+{
+  Byte* pBuffer = new Byte[headroom + mLength + tailroom];
+  if (mLength > 0) memcpy(pBuffer + headroom, data(), mLength);
+  delete[] mpBuffer;
+  mpBuffer = pBuffer;
+  mCapacity = headroom + mLength + tailroom;
+  mStart = headroom;
+}
@@ -0,0 +1,81 @@
+#ifndef PACKETBUFFER_H
+#define PACKETBUFFER_H
+
+#include "types.h"
+
+#define PACKET_HEADROOM 32 // vietos žemesnių lygių antraštėms (tinklo ir
+                           // kanalinio lygio reikia 17 baitų)
+
+/**
+ * Paketo buferis, perduodamas tarp transporto, tinklo ir kanalinio lygių.
+ *
+ * Prieš duomenis paliekama vietos (headroom), į kurią kiekvienas žemesnis
+ * lygis įrašo savo antraštę (push()), o aukštesnis ją nuima (pull()), todėl
+ * paketas perduodamas žemyn ir persiunčiamas nekopijuojant. Už duomenų
+ * galima palikti vietos jiems pridėti (put()).
+ * Buferis nekopijuojamas: lygis, pasiliekantis paketą (pvz., į eilę),
+ * paima jo turinį su swap(), o perdavusiojo buferis lieka tuščias.
+ */
+class PacketBuffer
+{
+  private:
+    Byte*    mpBuffer;
+    unsigned mCapacity;
+    unsigned mStart;    // duomenų pradžia buferyje
+    unsigned mLength;
+
+  public:
+    PacketBuffer();
+    PacketBuffer(unsigned length, unsigned headroom = PACKET_HEADROOM,
+                 unsigned tailroom = 0);
+
+    /**
+     * Sukuria buferį su duomenų kopija.
+     */
+    PacketBuffer(const Byte* data, unsigned length,
+                 unsigned headroom = PACKET_HEADROOM);
+    ~PacketBuffer();
+
+    Byte*       data() { return mpBuffer + mStart; }
+    unsigned    length() const { return mLength; }
+    unsigned    headroom() const { return mStart; }
+    unsigned    tailroom() const { return mCapacity - mStart - mLength; }
+
+    /**
+     * Prailgina duomenis length baitų į priekį (jei vietos nepakanka,
+     * duomenys perkeliami į didesnį buferį).
+     *
+     * @return nauja duomenų pradžia
+     */
+    Byte*       push(unsigned length);
+
+    /**
+     * Nuima length baitų nuo duomenų pradžios.
+     */
+    void        pull(unsigned length);
+
+    /**
+     * Prailgina duomenis length baitų gale.
+     *
+     * @return pridėtos dalies pradžia
+     */
+    Byte*       put(unsigned length);
+
+    /**
+     * Sutrumpina duomenis iki length baitų.
+     */
+    void        trim(unsigned length);
+
+    void        swap(PacketBuffer& rOther);
+
+  private:
+    PacketBuffer(const PacketBuffer&);
+    PacketBuffer& operator = (const PacketBuffer&);
+
+    /**
+     * Perkelia duomenis į naują buferį su nurodyta vieta prieš ir po jų.
+     */
+    void        reallocate(unsigned headroom, unsigned tailroom);
+};
+
+#endif
@@ -0,0 +1,79 @@
+#include "Reassembly.h"
+
+Reassembly::Reassembly(size_t memoryLimit, int timeout):
+  mMemory(0),
+  mMemoryLimit(memoryLimit),
+  mTimeout(timeout),
+  mEvicted(0)
+{ }
+
+Reassembly::~Reassembly()
+{
+  while (!mEntries.empty()) erase(mEntries.begin());
+}
+
+Fragment* Reassembly::add(IpAddress source, unsigned short id,
+                          unsigned dataLength, Byte* data, unsigned dataOffset,
+                          unsigned fragmentLength, const timespec& rNow)
+{
+  expire(rNow);
+  Key key(source, id);
+  auto it = mEntries.find(key);
+  if (it != mEntries.end() && it->second.fragment.length() != dataLength)
+  { // tuo pačiu ID siunčiamas kitas paketas
+    erase(it);
+    it = mEntries.end();
+  }
+  if (it == mEntries.end())
+  {
+    size_t size = Fragment::bufferSize(dataLength);
+    size_t capacity = BufferPool::capacity(size);
+    if (capacity == 0 || capacity > mMemoryLimit) return NULL;
+    while (mMemory + capacity > mMemoryLimit)
+    {
+      erase(mEntries.find(mLru.front()));
+      ++mEvicted;
+    }
+    it = mEntries.insert(make_pair(key, Entry())).first;
+    Entry& rEntry = it->second;
+    rEntry.pBuffer = mPool.get(size);
+    rEntry.size = size;
+    rEntry.fragment.reset(rEntry.pBuffer, dataLength);
+    rEntry.lruPosition = mLru.insert(mLru.end(), key);
+    mMemory += capacity;
+  }
+  else mLru.splice(mLru.end(), mLru, it->second.lruPosition);
+  Entry& rEntry = it->second;
+  rEntry.timeout = rNow;
+  add_milliseconds(rEntry.timeout, mTimeout);
+  if (!rEntry.fragment.add(data, dataOffset, fragmentLength)) return NULL;
+  return rEntry.fragment.isComplete() ? &rEntry.fragment : NULL;
+}
+
+void Reassembly::remove(IpAddress source, unsigned short id)
+{
+  auto it = mEntries.find(Key(source, id));
+  if (it != mEntries.end()) erase(it);
+}
+
+unsigned Reassembly::expire(const timespec& rNow)
+{
+  unsigned count = 0;
+  while (!mLru.empty())
+  {
+    auto it = mEntries.find(mLru.front());
+    if (!(it->second.timeout < rNow)) break;
+    erase(it);
+    ++count;
+  }
+  return count;
+}
+
+void Reassembly::erase(unordered_map<Key, Entry>::iterator it)
+{
+  Entry& rEntry = it->second;
+  mMemory -= BufferPool::capacity(rEntry.size);
+  mPool.put(rEntry.pBuffer, rEntry.size);
+  mLru.erase(rEntry.lruPosition);
+  mEntries.erase(it);
+}
@@ -0,0 +1,77 @@
+#ifndef REASSEMBLY_H
+#define REASSEMBLY_H
+
+#include <list>
+#include <unordered_map>
+#include "types.h"
+#include "hashes.h"
+#include "Fragment.h"
+#include "BufferPool.h"
+
+#define MAX_REASSEMBLY_MEMORY (1 << 20) // baitais
+
+/**
+ * Fragmentais gaunamų paketų surinkimas.
+ *
+ * Kiekvienas surenkamas paketas (atpažįstamas pagal siuntėją ir ID) laikomas
+ * iš BufferPool paimtame buferyje. Paketai surikiuoti pagal paskutinio
+ * fragmento gavimo laiką: jei po jo praėjo timeout milisekundžių, paketas
+ * išmetamas, o jei naujam paketui neužtenka atminties (buferių dydžių suma
+ * viršytų memoryLimit), išmetami seniausiai fragmentą gavę paketai. Taigi
+ * prarasti fragmentai neužima atminties amžinai.
+ */
+class Reassembly
+{
+  private:
+    typedef pair<IpAddress, unsigned short> Key;
+
+    struct Entry
+    {
+      Fragment            fragment;
+      Byte*               pBuffer;
+      size_t              size;         // paprašytas buferio dydis
+      timespec            timeout;
+      list<Key>::iterator lruPosition;
+    };
+
+  private:
+    unordered_map<Key, Entry> mEntries;
+    list<Key>                 mLru;         // priekyje – seniausiai gavę
+                                            // fragmentą
+    BufferPool                mPool;
+    size_t                    mMemory;      // užimtų buferių dydžių suma
+    size_t                    mMemoryLimit;
+    int                       mTimeout;     // milisekundėmis
+    unsigned                  mEvicted;     // kiek išmesta dėl atminties
+
+  public:
+    Reassembly(size_t memoryLimit, int timeout);
+    ~Reassembly();
+
+    /**
+     * Įrašo gautą fragmentą.
+     *
+     * @param rNow dabartinis (CLOCK_MONOTONIC) laikas
+     * @return surinktas paketas (jį reikia pašalinti su remove()) arba NULL
+     */
+    Fragment* add(IpAddress source, unsigned short id, unsigned dataLength,
+                  Byte* data, unsigned dataOffset, unsigned fragmentLength,
+                  const timespec& rNow);
+
+    void      remove(IpAddress source, unsigned short id);
+
+    /**
+     * Išmeta paketus, kurių fragmentų nebuvo gauta ilgiau nei timeout.
+     *
+     * @return kiek paketų išmesta
+     */
+    unsigned  expire(const timespec& rNow);
+
+    size_t    memoryUsage() const { return mMemory; }
+    unsigned  evicted() const { return mEvicted; }
+
+  private:
+    void      erase(unordered_map<Key, Entry>::iterator it);
+};
+
+#endif
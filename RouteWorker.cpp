@@ -0,0 +1,784 @@
+#include "RouteWorker.h"
+#include "NetworkLayer.h"
+#include <algorithm>
+
+RouteWorker::RouteWorker(unsigned spfThreads):
+  mStopping(false),
+  mpPublished(NULL),
+  mpJob(NULL),
+  mSelf(NO_NODE),
+  mPool(spfThreads),
+  mScratch(mPool.size()),
+  mTreeChanged(false)
+{
+  mThread = thread(&RouteWorker::run, this);
+}
+
+RouteWorker::~RouteWorker()
+{
+  {
+    lock_guard<mutex> lock(mMutex);
+    mStopping = true;
+  }
+  mCondition.notify_one();
+  mThread.join();
+  for (auto pJob : mJobs) delete pJob;
+  delete mpPublished.load();
+}
+
+void RouteWorker::submit(Job* pJob)
+{
+  {
+    lock_guard<mutex> lock(mMutex);
+    mJobs.push_back(pJob);
+  }
+  mCondition.notify_one();
+}
+
+RouteWorker::Table* RouteWorker::collect()
+{
+  if (mpPublished.load(memory_order_relaxed) == NULL) return NULL;
+  return mpPublished.exchange(NULL, memory_order_acquire);
+}
+
+const RouteWorker::Distance* RouteWorker::distanceTo(
+  const DistanceTable& rDistances, unsigned node)
+{
+  if (node >= rDistances.size() || rDistances[node].delay == UNREACHABLE)
+  {
+    return NULL;
+  }
+  return &rDistances[node];
+}
+
+unsigned RouteWorker::areaOf(IpAddress address, unsigned prefix)
+{
+  return prefix == 0 ? 0 : (unsigned long long)address >> (32 - prefix);
+}
+
+void RouteWorker::run()
+{
+  unique_lock<mutex> lock(mMutex);
+  while (true)
+  {
+    while (mJobs.empty() && !mStopping) mCondition.wait(lock);
+    if (mStopping) return;
+    Job* pJob = mJobs.front();
+    mJobs.pop_front();
+    bool last = mJobs.empty();
+    lock.unlock();
+    process(pJob, last);
+    lock.lock();
+  }
+}
+
+void RouteWorker::process(Job* pJob, bool publish)
+{
+  mpJob = pJob;
+  mSelf = pJob->self;
+  for (auto& rNode : pJob->nodes) mDatabase.bind(rNode.first, rNode.second);
+  for (auto& rChange : pJob->changes)
+  {
+    EdgeList& rEdges = rChange.second;
+    if (rEdges.empty()) mDatabase.removeState(rChange.first, rEdges);
+    else mDatabase.setEdges(rChange.first, rEdges);
+    updateTreeEdges(rChange.first, rEdges);
+  }
+  bool full = mDistances.size() != pJob->neighbours.size();
+  for (auto& rNeighbour : pJob->neighbours)
+  {
+    if (mDistances.find(rNeighbour.address) == mDistances.end()) full = true;
+  }
+  if (full) dijkstras();
+  else if (!pJob->changes.empty()) repairs();
+  kruskal();
+  if (publish)
+  {
+    Table* pOld = mpPublished.exchange(buildTable(), memory_order_acq_rel);
+    delete pOld; // tinklo lygis jos nespėjo paimti
+  }
+  mpJob = NULL;
+  delete pJob;
+}
+
+void RouteWorker::dijkstras()
+{
+  mDistances.clear();
+  mNeighbours.assign(mDatabase.size(), false);
+  for (auto& rNeighbour : mpJob->neighbours)
+  {
+    mNeighbours[mDatabase.find(rNeighbour.address)] = true;
+  }
+  vector<DistanceTable*> tables = neighbourTables();
+  mPool.run(tables.size(), [&](unsigned task, unsigned worker)
+  {
+    dijkstra(mDatabase.find(mpJob->neighbours[task].address),
+             *tables[task], mScratch[worker]);
+  });
+}
+
+void RouteWorker::dijkstra(unsigned root, DistanceTable& rDistances,
+                           Scratch& rScratch)
+{
+  Distance infinite;
+  infinite.delay = UNREACHABLE;
+  rDistances.assign(mDatabase.size(), infinite);
+  Distance zero;
+  zero.delay = 0;
+  zero.setMtu(MAX_MTU);
+  rDistances[root] = zero; // kiti keliai iki šaknies jo nepagerins
+  for (auto pEdge = mDatabase.outBegin(root);
+       pEdge != mDatabase.outEnd(root); ++pEdge)
+  {
+    improve(rDistances, pEdge->node, zero + *pEdge, rScratch.queue);
+  }
+  relax(rDistances, rScratch.queue);
+}
+
+void RouteWorker::repairs()
+{
+  mOldEdges.assign(mDatabase.size(), NULL);
+  for (auto& rChange : mpJob->changes)
+  {
+    if (mOldEdges[rChange.first] == NULL)
+    {
+      mOldEdges[rChange.first] = &rChange.second;
+    }
+  }
+  vector<DistanceTable*> tables = neighbourTables();
+  mPool.run(tables.size(), [&](unsigned task, unsigned worker)
+  {
+    repair(mDatabase.find(mpJob->neighbours[task].address),
+           *tables[task], mScratch[worker]);
+  });
+}
+
+vector<RouteWorker::DistanceTable*> RouteWorker::neighbourTables()
+{
+  vector<DistanceTable*> tables;
+  for (auto& rNeighbour : mpJob->neighbours)
+  {
+    tables.push_back(&mDistances[rNeighbour.address]);
+  }
+  return tables;
+}
+
+void RouteWorker::repair(unsigned root, DistanceTable& rDistances,
+                         Scratch& rScratch)
+{
+  // mazgai, kurių atstumą davė pailgėjusi ar MTU pakeitusi briauna (pirmiau
+  // visų, kad likę atstumai būtų gauti tik per nepailgėjusias briaunas)
+  Distance zero;
+  zero.delay = 0;
+  zero.setMtu(MAX_MTU);
+  vector<unsigned>& suspects = rScratch.suspects;
+  suspects.clear();
+  for (auto& rChange : mpJob->changes)
+  {
+    unsigned node = rChange.first;
+    if (node != root
+        && (!isTransit(node) || distanceTo(rDistances, node) == NULL))
+    {
+      continue;
+    }
+    const Distance& rBase = node == root ? zero : rDistances[node];
+    const Edge* pNewBegin = mDatabase.outBegin(node);
+    const Edge* pNewEnd = mDatabase.outEnd(node);
+    for (auto& rEdge : rChange.second)
+    {
+      const Edge* pNew = pNewBegin;
+      while (pNew != pNewEnd && pNew->node != rEdge.node) ++pNew;
+      if (pNew != pNewEnd && pNew->weight <= rEdge.weight
+          && pNew->mtu == rEdge.mtu)
+      {
+        continue;
+      }
+      if (distanceTo(rDistances, rEdge.node) != NULL
+          && rBase + rEdge == rDistances[rEdge.node])
+      {
+        suspects.push_back(rEdge.node);
+      }
+    }
+  }
+  // netekę atramos ir tie, kuriuos jie galėjo paremti
+  vector<unsigned>& invalid = rScratch.invalid;
+  invalid.clear();
+  while (!suspects.empty())
+  {
+    unsigned node = suspects.back();
+    suspects.pop_back();
+    if (node == root || distanceTo(rDistances, node) == NULL
+        || supported(root, rDistances, node))
+    {
+      continue;
+    }
+    Distance old = rDistances[node];
+    rDistances[node].delay = UNREACHABLE;
+    invalid.push_back(node);
+    if (!isTransit(node)) continue;
+    for (auto pEdge = mDatabase.outBegin(node);
+         pEdge != mDatabase.outEnd(node); ++pEdge)
+    {
+      if (distanceTo(rDistances, pEdge->node) != NULL
+          && old + *pEdge == rDistances[pEdge->node])
+      {
+        suspects.push_back(pEdge->node);
+      }
+    }
+    if (mOldEdges[node] == NULL) continue;
+    for (auto& rEdge : *mOldEdges[node]) // atstumai galėjo eiti senomis
+    {
+      if (distanceTo(rDistances, rEdge.node) != NULL
+          && old + rEdge == rDistances[rEdge.node])
+      {
+        suspects.push_back(rEdge.node);
+      }
+    }
+  }
+
+  for (auto target : invalid)
+  { // geriausias kelias per nepaliestus mazgus
+    for (auto pEdge = mDatabase.inBegin(target);
+         pEdge != mDatabase.inEnd(target); ++pEdge)
+    {
+      Distance distance;
+      if (pEdge->node == root) distance = zero + *pEdge;
+      else
+      {
+        if (!isTransit(pEdge->node)) continue;
+        const Distance* pDistance = distanceTo(rDistances, pEdge->node);
+        if (pDistance == NULL) continue;
+        distance = *pDistance + *pEdge;
+      }
+      improve(rDistances, target, distance, rScratch.queue);
+    }
+  }
+
+  // sutrumpėjusios ir naujos briaunos
+  for (auto& rChange : mpJob->changes)
+  {
+    unsigned node = rChange.first;
+    Distance base = zero;
+    if (node != root)
+    {
+      if (!isTransit(node)) continue;
+      const Distance* pDistance = distanceTo(rDistances, node);
+      if (pDistance == NULL) continue; // briaunas išplės relax(), jei reikės
+      base = *pDistance;
+    }
+    for (auto pEdge = mDatabase.outBegin(node);
+         pEdge != mDatabase.outEnd(node); ++pEdge)
+    {
+      improve(rDistances, pEdge->node, base + *pEdge, rScratch.queue);
+    }
+  }
+  relax(rDistances, rScratch.queue);
+}
+
+bool RouteWorker::supported(unsigned root, const DistanceTable& rDistances,
+                            unsigned node) const
+{
+  Distance zero;
+  zero.delay = 0;
+  zero.setMtu(MAX_MTU);
+  for (auto pEdge = mDatabase.inBegin(node);
+       pEdge != mDatabase.inEnd(node); ++pEdge)
+  {
+    if (pEdge->node == root)
+    {
+      if (zero + *pEdge == rDistances[node]) return true;
+      continue;
+    }
+    if (!isTransit(pEdge->node)) continue;
+    const Distance* pDistance = distanceTo(rDistances, pEdge->node);
+    if (pDistance != NULL && *pDistance + *pEdge == rDistances[node])
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+void RouteWorker::improve(DistanceTable& rDistances, unsigned node,
+                          const Distance& rDistance, IndexedHeap& rQueue)
+{
+  if (node >= rDistances.size())
+  {
+    Distance infinite;
+    infinite.delay = UNREACHABLE;
+    rDistances.resize(mDatabase.size(), infinite);
+  }
+  if (!(rDistance < rDistances[node])) return;
+  rDistances[node] = rDistance;
+  rQueue.push(node, rDistance.delay);
+}
+
+void RouteWorker::relax(DistanceTable& rDistances, IndexedHeap& rQueue)
+{
+  while (!rQueue.empty())
+  {
+    unsigned current = rQueue.pop();
+    if (!isTransit(current)) continue; // kitas kaimynas – tik kelio galas
+    Distance distance = rDistances[current];
+    for (auto pEdge = mDatabase.outBegin(current);
+         pEdge != mDatabase.outEnd(current); ++pEdge)
+    {
+      improve(rDistances, pEdge->node, distance + *pEdge, rQueue);
+    }
+  }
+}
+
+bool RouteWorker::isTransit(unsigned node) const
+{
+  return node != mSelf && (node >= mNeighbours.size() || !mNeighbours[node]);
+}
+
+void RouteWorker::updateTreeEdges(unsigned node, const EdgeList& rOld)
+{
+  const Edge* pNewBegin = mDatabase.outBegin(node);
+  const Edge* pNewEnd = mDatabase.outEnd(node);
+  TreeEdge key;
+  key.from = mDatabase.address(node);
+  key.fromNode = node;
+  key.inTree = false;
+  for (auto& rEdge : rOld)
+  {
+    const Edge* pNew = pNewBegin;
+    while (pNew != pNewEnd && pNew->node != rEdge.node) ++pNew;
+    if (pNew != pNewEnd && pNew->weight == rEdge.weight) continue;
+    key.weight = rEdge.weight;
+    key.to = mDatabase.address(rEdge.node);
+    key.toNode = rEdge.node;
+    auto it = mTreeEdges.find(key);
+    if (it == mTreeEdges.end()) continue;
+    bool inTree = it->inTree;
+    if (inTree) unlinkTreeEdge(it);
+    mTreeEdges.erase(it);
+    if (!inTree) continue;
+    if (pNew == pNewEnd || pNew->weight > rEdge.weight)
+    {
+      mTreeChanged = true;
+      continue;
+    }
+    key.weight = pNew->weight; // sutrumpėjusi medžio briauna lieka medyje
+    linkTreeEdge(mTreeEdges.insert(key).first);
+  }
+  for (const Edge* pEdge = pNewBegin; pEdge != pNewEnd; ++pEdge)
+  {
+    key.weight = pEdge->weight;
+    key.to = mDatabase.address(pEdge->node);
+    key.toNode = pEdge->node;
+    auto inserted = mTreeEdges.insert(key);
+    if (inserted.second) insertTreeEdge(inserted.first);
+  }
+}
+
+void RouteWorker::insertTreeEdge(TreeEdgeIt it)
+{
+  if (mTreeChanged || it->fromNode == it->toNode) return;
+  TreeEdgeIt heaviest = heaviestOnPath(it->fromNode, it->toNode);
+  if (heaviest != mTreeEdges.end())
+  {
+    if (*heaviest < *it) return;
+    unlinkTreeEdge(heaviest);
+  }
+  linkTreeEdge(it);
+}
+
+RouteWorker::TreeEdgeIt RouteWorker::heaviestOnPath(unsigned from,
+                                                    unsigned to)
+{
+  if (from >= mTreeLinks.size() || to >= mTreeLinks.size())
+  {
+    return mTreeEdges.end();
+  }
+  vector<TreeEdgeIt> via(mTreeLinks.size(), mTreeEdges.end());
+  vector<bool> seen(mTreeLinks.size(), false);
+  vector<unsigned> stack(1, from);
+  seen[from] = true;
+  while (!stack.empty() && !seen[to])
+  {
+    unsigned node = stack.back();
+    stack.pop_back();
+    for (auto link : mTreeLinks[node])
+    {
+      unsigned next = link->fromNode == node ? link->toNode : link->fromNode;
+      if (seen[next]) continue;
+      seen[next] = true;
+      via[next] = link;
+      stack.push_back(next);
+    }
+  }
+  if (!seen[to]) return mTreeEdges.end();
+  TreeEdgeIt heaviest = via[to];
+  for (unsigned node = to; node != from;)
+  {
+    TreeEdgeIt link = via[node];
+    if (*heaviest < *link) heaviest = link;
+    node = link->fromNode == node ? link->toNode : link->fromNode;
+  }
+  return heaviest;
+}
+
+void RouteWorker::linkTreeEdge(TreeEdgeIt it)
+{
+  it->inTree = true;
+  unsigned size = max(it->fromNode, it->toNode) + 1;
+  if (mTreeLinks.size() < size) mTreeLinks.resize(size);
+  mTreeLinks[it->fromNode].push_back(it);
+  mTreeLinks[it->toNode].push_back(it);
+  if (it->toNode == mSelf) mSpanningTree.insert(it->from);
+  else if (it->fromNode == mSelf) mSpanningTree.insert(it->to);
+}
+
+void RouteWorker::unlinkTreeEdge(TreeEdgeIt it)
+{
+  it->inTree = false;
+  for (unsigned node : { it->fromNode, it->toNode })
+  {
+    vector<TreeEdgeIt>& rLinks = mTreeLinks[node];
+    auto linkIt = find(rLinks.begin(), rLinks.end(), it);
+    *linkIt = rLinks.back();
+    rLinks.pop_back();
+  }
+  if (it->toNode == mSelf) mSpanningTree.erase(it->from);
+  else if (it->fromNode == mSelf) mSpanningTree.erase(it->to);
+}
+
+void RouteWorker::kruskal()
+{
+  if (!mTreeChanged) return;
+  mTreeChanged = false;
+  mSpanningTree.clear();
+  for (auto& rLinks : mTreeLinks) rLinks.clear();
+  mTreeSets.reset(mDatabase.size());
+  for (auto it = mTreeEdges.begin(); it != mTreeEdges.end(); ++it)
+  {
+    it->inTree = false;
+    if (mTreeSets.unite(it->fromNode, it->toNode)) linkTreeEdge(it);
+  }
+}
+
+RouteWorker::Table* RouteWorker::buildTable()
+{
+  Table* pTable = new Table;
+  Table& rTable = *pTable;
+  rTable.self = mSelf;
+  rTable.area = areaOf(mDatabase.address(mSelf), mpJob->areaPrefix);
+  rTable.spanningTree = mSpanningTree;
+  FibEntry noRoute = { 0, 0 };
+  rTable.fib.assign(mDatabase.size(), noRoute);
+  rTable.selfDistances.assign(mDatabase.size(), INFINITE_DELAY);
+  vector<pair<const Neighbour*, const DistanceTable*> > neighbours;
+  vector<const Neighbour*> direct(rTable.fib.size(), NULL);
+  for (auto& rNeighbour : mpJob->neighbours)
+  {
+    neighbours.push_back(make_pair(&rNeighbour,
+                                   &mDistances[rNeighbour.address]));
+    direct[mDatabase.find(rNeighbour.address)] = &rNeighbour;
+  }
+  neighbourDistances();
+  vector<double> weights, remaining, returns;
+  vector<LinkLayer*> links;
+  for (unsigned destination = 0; destination < rTable.fib.size();
+       destination++)
+  {
+    if (destination == mSelf) continue;
+    unsigned first = rTable.nextHops.size();
+    unsigned long long maxDistance = 0;
+    weights.clear();
+    remaining.clear();
+    returns.clear();
+    links.clear();
+    double shortest = INFINITE_DELAY; // D(S,D)
+    const Neighbour* pDirect = direct[destination];
+    if (pDirect != NULL)
+    {
+      NextHop nextHop = { pDirect->address, 0, pDirect->mtu, 1, 0, 0 };
+      rTable.nextHops.push_back(nextHop);
+      weights.push_back(pDirect->delay + CONSTANT_WEIGTH);
+      remaining.push_back(0);
+      returns.push_back(mToSelf[pDirect - &mpJob->neighbours[0]]);
+      shortest = mFromSelf[pDirect - &mpJob->neighbours[0]];
+      links.push_back(pDirect->pLinkLayer);
+    }
+    for (auto& rNeighbour : neighbours)
+    {
+      if (rNeighbour.first == pDirect) continue;
+      const Distance* pDistance = distanceTo(*rNeighbour.second,
+                                             destination);
+      if (pDistance == NULL) continue;
+      Distance distance = *pDistance + rNeighbour.first->delay;
+      unsigned ttl = distance.hops() * 3 / 2;
+      unsigned mtu = min<unsigned>(distance.mtu(), rNeighbour.first->mtu);
+      NextHop nextHop = { rNeighbour.first->address, ttl, mtu, 1, 0, 0 };
+      rTable.nextHops.push_back(nextHop);
+      weights.push_back(distance.delay);
+      unsigned index = rNeighbour.first - &mpJob->neighbours[0];
+      remaining.push_back(pDistance->delay);
+      returns.push_back(mToSelf[index]);
+      if (shortest > mFromSelf[index] + pDistance->delay)
+      {
+        shortest = mFromSelf[index] + pDistance->delay;
+      }
+      links.push_back(rNeighbour.first->pLinkLayer);
+      if (maxDistance < distance.delay) maxDistance = distance.delay;
+    }
+    if (weights.empty()) continue;
+    rTable.selfDistances[destination] = *min_element(weights.begin(),
+                                                     weights.end());
+    buildBackups(&rTable.nextHops[first], weights, remaining, returns,
+                 shortest, links);
+    if (pDirect != NULL)
+    { // siunčiama tiesiogiai, kiti kaimynai – tik atsarginis kelias
+      NextHop& rDirect = rTable.nextHops[first];
+      if (rDirect.backup != 0)
+      {
+        rTable.nextHops[first + 1] = rTable.nextHops[first + rDirect.backup];
+        rTable.nextHops[first + 1].backup = 1;
+        rDirect.backup = 1;
+      }
+      rTable.nextHops.resize(first + 1 + rDirect.backup);
+      rTable.fib[destination].first = first;
+      rTable.fib[destination].count = 1;
+      continue;
+    }
+    for (auto& rWeight : weights) rWeight = maxDistance / rWeight;
+    buildAlias(&rTable.nextHops[first], weights);
+    rTable.fib[destination].first = first;
+    rTable.fib[destination].count = weights.size();
+  }
+  buildAreaFib(rTable);
+  rTable.addresses.resize(mDatabase.size());
+  for (unsigned node = 0; node < mDatabase.size(); node++)
+  {
+    rTable.addresses[node] = mDatabase.address(node);
+  }
+  return pTable;
+}
+
+void RouteWorker::buildAreaFib(Table& rTable)
+{
+  unsigned prefix = mpJob->areaPrefix;
+  // sritis – (kaimynas, atstumas nuo jo)
+  map<unsigned, vector<pair<const Neighbour*, unsigned long long> > >
+    candidates;
+  unordered_map<unsigned, unsigned long long> costs;
+  for (auto& rNeighbour : mpJob->neighbours)
+  {
+    costs.clear();
+    unsigned area = areaOf(rNeighbour.address, prefix);
+    if (area != rTable.area)
+    {
+      costs[area] = 0;
+      auto it = mpJob->summaries.find(rNeighbour.address);
+      if (it != mpJob->summaries.end())
+      {
+        for (auto& rRoute : it->second)
+        {
+          if (rRoute.area == rTable.area || costs.count(rRoute.area) > 0)
+          {
+            continue;
+          }
+          costs[rRoute.area] = rRoute.cost;
+        }
+      }
+    }
+    else
+    {
+      unsigned neighbour = mDatabase.find(rNeighbour.address);
+      for (auto& rSummary : mpJob->summaries)
+      {
+        if (areaOf(rSummary.first, prefix) != rTable.area) continue;
+        unsigned border = mDatabase.find(rSummary.first);
+        if (border == NO_NODE || border == mSelf) continue;
+        unsigned long long distance = 0;
+        if (border != neighbour)
+        {
+          if (!isTransit(border)) continue; // per kaimyną – tiesiogiai
+          const Distance* pDistance = distanceTo(mDistances[rNeighbour
+                                                            .address],
+                                                 border);
+          if (pDistance == NULL) continue;
+          distance = pDistance->delay;
+        }
+        for (auto& rRoute : rSummary.second)
+        {
+          if (rRoute.area == rTable.area) continue;
+          auto it = costs.find(rRoute.area);
+          if (it == costs.end() || it->second > distance + rRoute.cost)
+          {
+            costs[rRoute.area] = distance + rRoute.cost;
+          }
+        }
+      }
+    }
+    for (auto& rCost : costs)
+    {
+      candidates[rCost.first].push_back(make_pair(&rNeighbour,
+                                                  rCost.second));
+    }
+  }
+  vector<double> weights, remaining, returns;
+  vector<LinkLayer*> links;
+  for (auto& rCandidates : candidates)
+  {
+    unsigned first = rTable.nextHops.size();
+    unsigned long long maxDistance = 0;
+    weights.clear();
+    remaining.clear();
+    returns.clear();
+    links.clear();
+    double shortest = INFINITE_DELAY; // D(S,D)
+    for (auto& rCandidate : rCandidates.second)
+    {
+      const Neighbour* pNeighbour = rCandidate.first;
+      unsigned long long distance = rCandidate.second + pNeighbour->delay
+                                    + CONSTANT_WEIGTH;
+      NextHop nextHop = { pNeighbour->address, BROADCAST_TTL,
+                          pNeighbour->mtu, 1, 0, 0 };
+      rTable.nextHops.push_back(nextHop);
+      weights.push_back(distance);
+      remaining.push_back(rCandidate.second);
+      unsigned index = pNeighbour - &mpJob->neighbours[0];
+      returns.push_back(mToSelf[index]);
+      if (shortest > mFromSelf[index] + rCandidate.second)
+      {
+        shortest = mFromSelf[index] + rCandidate.second;
+      }
+      links.push_back(pNeighbour->pLinkLayer);
+      if (maxDistance < distance) maxDistance = distance;
+    }
+    buildBackups(&rTable.nextHops[first], weights, remaining, returns,
+                 shortest, links);
+    for (auto& rWeight : weights) rWeight = maxDistance / rWeight;
+    buildAlias(&rTable.nextHops[first], weights);
+    rTable.areaFib[rCandidates.first].first = first;
+    rTable.areaFib[rCandidates.first].count = weights.size();
+  }
+}
+
+void RouteWorker::buildAlias(NextHop* pHops, vector<double>& weights)
+{
+  unsigned count = weights.size();
+  double total = 0;
+  for (auto weight : weights) total += weight;
+  vector<unsigned> small, large;
+  for (unsigned i = 0; i < count; i++)
+  {
+    weights[i] *= count / total;
+    if (weights[i] < 1) small.push_back(i);
+    else large.push_back(i);
+  }
+  while (!small.empty() && !large.empty())
+  {
+    unsigned less = small.back(), more = large.back();
+    small.pop_back();
+    pHops[less].probability = weights[less];
+    pHops[less].alias = more;
+    weights[more] -= 1 - weights[less];
+    if (weights[more] < 1)
+    {
+      large.pop_back();
+      small.push_back(more);
+    }
+  }
+  // likę (ir dėl apvalinimo paklaidų) imami visada
+  for (auto i : small) pHops[i].probability = 1;
+  for (auto i : large) pHops[i].probability = 1;
+}
+
+void RouteWorker::buildBackups(NextHop* pHops, const vector<double>& distances,
+                               const vector<double>& remaining,
+                               const vector<double>& returns,
+                               double shortest,
+                               const vector<LinkLayer*>& links)
+{
+  unsigned count = distances.size();
+  unsigned best = count;   // artimiausias iš tinkamų
+  unsigned second = count; // artimiausias po best
+  unsigned other = count;  // artimiausias kitu nei best kanalu
+  for (unsigned i = 0; i < count; i++)
+  { // LFA: kaimyno kelias į adresatą neina per šį mazgą
+    if (!(remaining[i] < returns[i] + shortest)) continue;
+    if (best == count || distances[i] < distances[best])
+    {
+      second = best;
+      best = i;
+    }
+    else if (second == count || distances[i] < distances[second]) second = i;
+  }
+  for (unsigned i = 0; i < count && best != count; i++)
+  {
+    if (!(remaining[i] < returns[i] + shortest) || links[i] == links[best])
+    {
+      continue;
+    }
+    if (other == count || distances[i] < distances[other]) other = i;
+  }
+  for (unsigned i = 0; i < count; i++)
+  {
+    if (best == count) pHops[i].backup = i;
+    else if (links[i] != links[best]) pHops[i].backup = best;
+    else if (other != count) pHops[i].backup = other;
+    else if (i != best) pHops[i].backup = best;
+    else pHops[i].backup = second == count ? i : second;
+  }
+}
+
+void RouteWorker::neighbourDistances()
+{
+  // kaimynų ir šio mazgo (paskutinis) grafas: tarp jų – atstumai iš kaimynų
+  // lentelių, t. y. keliai, neinantys per kitus kaimynus; trumpiausi keliai
+  // jame – tikri atstumai tarp šių mazgų (Floydo-Voršalo algoritmas)
+  unsigned count = mpJob->neighbours.size();
+  vector<vector<double> > distances(count + 1,
+                                    vector<double>(count + 1, INFINITE_DELAY));
+  for (unsigned from = 0; from < count; from++)
+  {
+    const Neighbour& rNeighbour = mpJob->neighbours[from];
+    const DistanceTable& rTable = mDistances[rNeighbour.address];
+    for (unsigned to = 0; to < count; to++)
+    {
+      const Distance* pDistance = distanceTo(rTable, mDatabase.find(
+                                                 mpJob->neighbours[to]
+                                                 .address));
+      if (pDistance != NULL) distances[from][to] = pDistance->delay;
+    }
+    const Distance* pDistance = distanceTo(rTable, mSelf);
+    // be kaimyno LS paketo kanalas laikomas simetrišku
+    distances[from][count] = pDistance != NULL ? pDistance->delay
+                             : rNeighbour.delay + CONSTANT_WEIGTH;
+    distances[count][from] = rNeighbour.delay + CONSTANT_WEIGTH;
+  }
+  distances[count][count] = 0;
+  for (unsigned via = 0; via <= count; via++)
+  {
+    for (unsigned from = 0; from <= count; from++)
+    {
+      for (unsigned to = 0; to <= count; to++)
+      {
+        double distance = distances[from][via] + distances[via][to];
+        if (distance < distances[from][to]) distances[from][to] = distance;
+      }
+    }
+  }
+  mFromSelf.resize(count);
+  mToSelf.resize(count);
+  for (unsigned i = 0; i < count; i++)
+  {
+    mFromSelf[i] = distances[count][i];
+    mToSelf[i] = distances[i][count];
+  }
+}
+
+unsigned RouteWorker::Table::find(IpAddress address, unsigned node) const
+{
+  return node < addresses.size() && addresses[node] == address ? node
+                                                               : NO_NODE;
+}
+
+unsigned long long RouteWorker::Table::distanceFromSelf(unsigned node) const
+{
+  return node < selfDistances.size() ? selfDistances[node] : INFINITE_DELAY;
+}
@@ -0,0 +1,431 @@
+#ifndef ROUTEWORKER_H
+#define ROUTEWORKER_H
+
+#include <vector>
+#include <deque>
+#include <set>
+#include <map>
+#include <unordered_set>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include "types.h"
+#include "LinkStateDatabase.h"
+#include "IndexedHeap.h"
+#include "DisjointSets.h"
+#include "Fragment.h"
+#include "ThreadPool.h"
+
+#define CONSTANT_WEIGTH  1000
+#define INFINITE_DELAY 0xffffffffffffffffULL
+#define DELAY_BITS     24 // Distance::delay plotis
+#define UNREACHABLE    ((1U << DELAY_BITS) - 1) // Distance::delay
+                                                // nepasiekiamam mazgui
+#define SPF_THREADS      0 // 0 – po vieną kiekvienam branduoliui
+
+class LinkLayer;
+
+/**
+ * Maršrutų skaičiavimas atskiroje gijoje.
+ *
+ * Tinklo lygis (įvykių ciklo gijoje) pateikia užduotis (Job): nuo praeitos
+ * užduoties pasikeitusių mazgų briaunas, kaimynus ir pasienio mazgų santraukas.
+ * Gija laiko savo LS duomenų bazės kopiją su tais pačiais mazgų numeriais ir ją
+ * papildo užduoties briaunomis, todėl visa duomenų bazė niekada nekopijuojama.
+ * Gija užduotis apdoroja eilės tvarka: pataiso ar iš naujo apskaičiuoja
+ * atstumus nuo kiekvieno kaimyno, jungiamąjį medį ir sudaro naują persiuntimo
+ * lentelę (Table). Atstumai ir medžio briaunos lieka gijoje tarp užduočių,
+ * todėl pasikeitus mazgams jie tik pataisomi (žr. NetworkLayer.h „Atstumų
+ * perskaičiavimas“). Lentelėje lieka tik atstumai nuo šio mazgo.
+ *
+ * Paskelbta lentelė nebekeičiama. Ji perduodama per atominę rodyklę: gija
+ * įrašo naują (išmesdama nepaimtą senesnę), o tinklo lygis ją pasiima
+ * collect() ir atlaisvina savo turėtą. Taigi paketų siuntimas niekada
+ * nelaukia skaičiavimo ir neima jokio užrakto – tik naudojasi paskutine
+ * paimta lentele. Kol laukia daugiau užduočių, tarpinės lentelės neskelbiamos.
+ *
+ * Atstumai nuo skirtingų kaimynų vienas nuo kito nepriklauso, todėl jie
+ * skaičiuojami (ar taisomi) lygiagrečiai gijų telkinyje (mPool). Duomenų
+ * bazė ir kaimynų žymės tuo metu tik skaitomos, kiekviena užduotis rašo tik
+ * į savo kaimyno atstumų lentelę, o Dijkstros eilė ir kiti pagalbiniai
+ * masyvai (Scratch) – atskiri kiekvienai telkinio gijai.
+ */
+class RouteWorker
+{
+  public:
+    /**
+     * Atstumų lentelės įrašas. Lentelių yra po vieną kiekvienam kaimynui ir
+     * jos apima visus srities mazgus, todėl įrašas telpa į 4 baitus (atminties
+     * palyginimas – distbench.cpp): ilgesni nei UNREACHABLE - 1 keliai
+     * neskiriami, MTU saugomas FRAGMENT_CHUNK dalimis (fragmentų ilgiui to
+     * pakanka, žr. NetworkLayer::fragmentLength()), o šuolių skaičius
+     * įvertinamas pagal atstumą – kiekvienas šuolis prideda bent
+     * CONSTANT_WEIGTH. Ankstesnis kelio mazgas nesaugomas (žr. repair()).
+     */
+    struct Distance
+    {
+      unsigned delay  : DELAY_BITS;
+      unsigned chunks : 32 - DELAY_BITS; // mažiausias kelio kanalo MTU,
+                                         // padalytas iš FRAGMENT_CHUNK
+
+      /**
+       * @return ne mažiau nei kelio šuolių skaičius (lygu jam, jei kanalų
+       *         kainų suma mažesnė už CONSTANT_WEIGTH)
+       */
+      unsigned hops() const
+      {
+        return delay / CONSTANT_WEIGTH;
+      }
+
+      unsigned mtu() const
+      {
+        return chunks * FRAGMENT_CHUNK;
+      }
+
+      void setMtu(unsigned mtu)
+      {
+        chunks = mtu / FRAGMENT_CHUNK;
+      }
+
+      bool operator < (const Distance& other) const
+      {
+        return delay < other.delay;
+      }
+
+      bool operator == (const Distance& other) const
+      {
+        return delay == other.delay && chunks == other.chunks;
+      }
+
+      Distance operator + (unsigned additionalDelay) const
+      {
+        Distance result;
+        unsigned long long sum = (unsigned long long)delay + additionalDelay
+                                 + CONSTANT_WEIGTH;
+        result.delay = sum < UNREACHABLE ? sum : UNREACHABLE - 1;
+        result.chunks = chunks;
+        return result;
+      }
+
+      Distance operator + (const LinkStateDatabase::Edge& rEdge) const
+      {
+        Distance result = *this + rEdge.weight;
+        if (rEdge.mtu < result.mtu()) result.setMtu(rEdge.mtu);
+        return result;
+      }
+    };
+
+    typedef vector<Distance>              DistanceTable; // pagal mazgo numerį;
+                                                         // nepasiekiamų delay
+                                                         // – UNREACHABLE
+    typedef LinkStateDatabase::Edge       Edge;
+    typedef LinkStateDatabase::EdgeList   EdgeList;
+
+    struct NextHop
+    {
+      IpAddress     neighbour;
+      unsigned      ttl;
+      unsigned      mtu;         // kelio per šį kaimyną MTU
+      float         probability; // kad bus imtas šis, o ne alias
+      unsigned      alias;       // kitas to paties adresato kaimynas
+      unsigned      backup;      // atsarginis, jei šio kaimyno nebeliko
+                                 // (žr. NetworkLayer.h „Maršrutizavimas“)
+    };
+
+    struct FibEntry
+    {
+      unsigned      first;       // pirmas NextHop nextHops masyve
+      unsigned      count;       // 0 – kelio nėra
+    };
+
+    struct Neighbour
+    {
+      IpAddress     address;
+      unsigned      delay;       // kanalo kaina
+      unsigned      mtu;
+      LinkLayer*    pLinkLayer;  // tik palyginimui, ar kanalas tas pats
+    };
+
+    struct AreaRoute
+    {
+      unsigned      area;
+      unsigned      cost;  // atstumas nuo skelbiančio mazgo
+      unsigned      via;   // per kurią kaimyninę sritį
+      unsigned      hops;  // per kiek sričių
+    };
+
+    struct Job
+    {
+      vector<pair<unsigned, IpAddress> >            nodes; // užduotyje
+                                              // minimų mazgų numeriai
+      unsigned                                      self;
+      unsigned                                      areaPrefix;
+      vector<Neighbour>                             neighbours;
+      unordered_map<IpAddress, vector<AreaRoute> >  summaries; // iš pasienio
+                                                             // mazgų
+      unordered_map<unsigned, EdgeList>             changes; // mazgas –
+                          // naujos briaunos (įrašius į kopiją – senosios)
+    };
+
+    struct Table
+    {
+      vector<IpAddress>                        addresses; // pagal mazgo
+                                                          // numerį
+      unsigned                                 self;
+      unsigned                                 area;
+      vector<unsigned long long>               selfDistances; // pagal mazgo
+                                                 // numerį; nepasiekiamų –
+                                                 // INFINITE_DELAY
+      vector<FibEntry>                         fib; // pagal mazgo numerį
+      vector<NextHop>                          nextHops;
+      unordered_map<unsigned, FibEntry>        areaFib; // pagal sritį
+      unordered_set<IpAddress>                 spanningTree;
+
+      /**
+       * @param node address numeris tinklo lygio duomenų bazėje
+       * @return node, jei lentelėje šis numeris žymi address, kitaip
+       *         NO_NODE (numeris galėjo būti atlaisvintas ir vėl suteiktas)
+       */
+      unsigned find(IpAddress address, unsigned node) const;
+
+      /**
+       * @return atstumas nuo šio mazgo iki savo srities mazgo node arba
+       *         INFINITE_DELAY
+       */
+      unsigned long long distanceFromSelf(unsigned node) const;
+    };
+
+  private:
+    struct TreeEdge
+    {
+      unsigned      weight;
+      IpAddress     from;
+      IpAddress     to;
+      unsigned      fromNode;
+      unsigned      toNode;
+      mutable bool  inTree;   // ar priklauso minimaliam jungiamajam medžiui
+
+      bool operator < (const TreeEdge& other) const
+      {
+        if (weight != other.weight) return weight < other.weight;
+        if (from != other.from) return from < other.from;
+        return to < other.to;
+      }
+    };
+
+    typedef set<TreeEdge>::iterator TreeEdgeIt;
+
+    /**
+     * Vienos telkinio gijos pagalbiniai duomenys SPF skaičiavimui.
+     */
+    struct Scratch
+    {
+      IndexedHeap      queue;
+      vector<unsigned> invalid;  // repair() netekę atstumo mazgai
+      vector<unsigned> suspects; // repair() tikrintini mazgai
+    };
+
+  private:
+    thread                                   mThread;
+    mutex                                    mMutex;
+    condition_variable                       mCondition;
+    deque<Job*>                              mJobs;
+    bool                                     mStopping;
+    atomic<Table*>                           mpPublished;
+
+    // toliau – tik gijos duomenys
+    Job*                                     mpJob; // apdorojama užduotis
+    LinkStateDatabase                        mDatabase; // tinklo lygio
+                                                        // duomenų bazės kopija
+    unsigned                                 mSelf;
+    unordered_map<IpAddress, DistanceTable>  mDistances; // nuo kaimyno
+    vector<bool>                             mNeighbours;
+    vector<const EdgeList*>                  mOldEdges; // repairs() užduoties
+                                                        // mazgų senos briaunos
+    ThreadPool                               mPool;
+    vector<Scratch>                          mScratch; // pagal telkinio giją
+    set<TreeEdge>                            mTreeEdges;
+    vector<vector<TreeEdgeIt> >              mTreeLinks; // medžio briaunos
+                                                         // pagal mazgą
+    DisjointSets                             mTreeSets;
+    bool                                     mTreeChanged; // reikia viso
+                                                           // Kruskalo
+    unordered_set<IpAddress>                 mSpanningTree;
+    vector<double>                           mFromSelf; // D(S,N) pagal
+                                                        // užduoties kaimyną
+    vector<double>                           mToSelf;   // D(N,S)
+
+  public:
+    /**
+     * @param spfThreads kiek gijų skaičiuoja atstumus (žr. ThreadPool)
+     */
+    RouteWorker(unsigned spfThreads);
+    ~RouteWorker();
+
+    /**
+     * Įdeda užduotį į eilę (ją vėliau sunaikina gija).
+     */
+    void     submit(Job* pJob);
+
+    /**
+     * @return naujausia nuo praeito kvietimo paskelbta lentelė (ją
+     *         sunaikina kviečiantysis) arba NULL
+     */
+    Table*   collect();
+
+    /**
+     * @return atstumas nuo lentelės šaknies iki node arba NULL, jei node
+     *         nepasiekiamas
+     */
+    static const Distance* distanceTo(const DistanceTable& rDistances,
+                                      unsigned node);
+
+    /**
+     * @return srities, kuriai priklauso address, numeris (pirmieji prefix
+     *         adreso bitų; žr. NetworkLayer.h „Sritys“)
+     */
+    static unsigned areaOf(IpAddress address, unsigned prefix);
+
+  private:
+    /**
+     * Gijos ciklas: ima užduotis iš eilės, kol sunaikinamas objektas.
+     */
+    void     run();
+
+    /**
+     * Atnaujina gijos duomenis pagal užduotį ir, jei publish, paskelbia
+     * naują lentelę.
+     */
+    void     process(Job* pJob, bool publish);
+
+    /**
+     * Iš naujo apskaičiuoja atstumus nuo visų kaimynų (lygiagrečiai).
+     */
+    void     dijkstras();
+    void     dijkstra(unsigned root, DistanceTable& rDistances,
+                      Scratch& rScratch);
+
+    /**
+     * Lygiagrečiai pataiso atstumus nuo visų kaimynų pagal užduoties
+     * pasikeitimus.
+     */
+    void     repairs();
+
+    /**
+     * Pataiso atstumus nuo root pasikeitus užduoties mazgų kaimynams (žr.
+     * NetworkLayer.h „Atstumų perskaičiavimas“).
+     */
+    void     repair(unsigned root, DistanceTable& rDistances,
+                    Scratch& rScratch);
+
+    /**
+     * @return ar atstumą iki node (ne root) vis dar duoda kuri nors į jį
+     *         einanti briauna nuo root arba pasiekiamo tranzitinio mazgo
+     */
+    bool     supported(unsigned root, const DistanceTable& rDistances,
+                       unsigned node) const;
+
+    /**
+     * Įrašo atstumą iki node, jei jis trumpesnis už žinomą, ir įdeda node į
+     * Dijkstros algoritmo eilę (rQueue).
+     */
+    void     improve(DistanceTable& rDistances, unsigned node,
+                     const Distance& rDistance, IndexedHeap& rQueue);
+
+    /**
+     * Dijkstros algoritmo tęsinys: ima mazgus iš rQueue ir mažina atstumus iki
+     * jų kaimynų, kol eilė ištuštėja.
+     */
+    void     relax(DistanceTable& rDistances, IndexedHeap& rQueue);
+
+    /**
+     * Įsitikina, kad mDistances yra visų užduoties kaimynų lentelės (kol
+     * dirba telkinys, mDistances keisti negalima).
+     *
+     * @return lentelės užduoties kaimynų tvarka
+     */
+    vector<DistanceTable*> neighbourTables();
+
+    /**
+     * @return ar kelias nuo kaimyno gali eiti per node (ne per šį mazgą ir ne
+     *         per kitus kaimynus)
+     */
+    bool     isTransit(unsigned node) const;
+
+    /**
+     * Pakeičia mTreeEdges pasikeitus mazgo briaunoms. Atsiradusią ar
+     * sutrumpėjusią briauną iškart įtraukia į medį (insertTreeEdge()), o
+     * išnykus ar pailgėjus medžio briaunai pažymi, kad medį reikės
+     * perskaičiuoti visą.
+     */
+    void     updateTreeEdges(unsigned node, const EdgeList& rOld);
+
+    /**
+     * Įtraukia į medį naują ne medžio briauną it: jei jos galai dar
+     * nesujungti – tiesiog prideda, o jei sujungti ir ji lengvesnė už
+     * sunkiausią medžio kelio tarp jų briauną – pakeičia ją.
+     */
+    void     insertTreeEdge(TreeEdgeIt it);
+
+    /**
+     * @return sunkiausia medžio kelio tarp from ir to briauna arba
+     *         mTreeEdges.end(), jei jie nesujungti
+     */
+    TreeEdgeIt heaviestOnPath(unsigned from, unsigned to);
+
+    /**
+     * Prideda briauną it prie medžio (mTreeLinks, mSpanningTree) arba ją
+     * pašalina.
+     */
+    void     linkTreeEdge(TreeEdgeIt it);
+    void     unlinkTreeEdge(TreeEdgeIt it);
+
+    /**
+     * Jei reikia, perskaičiuoja visą minimalų jungiamąjį medį.
+     */
+    void     kruskal();
+
+    /**
+     * Sudaro persiuntimo lentelę pagal dabartinius atstumus.
+     */
+    Table*   buildTable();
+
+    /**
+     * Sudaro kitų sričių persiuntimo lentelę (areaFib) pagal santraukas.
+     */
+    void     buildAreaFib(Table& rTable);
+
+    /**
+     * Užpildo NextHop::probability ir alias (Vose algoritmas).
+     *
+     * @param pHops   adresato kaimynai
+     * @param weights jų svoriai (sugadinami)
+     */
+    static void buildAlias(NextHop* pHops, vector<double>& weights);
+
+    /**
+     * Užpildo NextHop::backup: artimiausias kitas kaimynas, pirmiausia –
+     * kitu kanalu, tenkinantis LFA sąlygą D(N,D) < D(N,S) + D(S,D) (žr.
+     * NetworkLayer.h „Maršrutizavimas“); jei tokio nėra, – pats kaimynas.
+     *
+     * @param pHops     adresato kaimynai
+     * @param distances atstumai iki adresato per juos
+     * @param remaining atstumai nuo jų iki adresato, D(N,D)
+     * @param returns   atstumai nuo jų iki šio mazgo, D(N,S)
+     * @param shortest  atstumas nuo šio mazgo iki adresato, D(S,D)
+     * @param links     jų kanalai
+     */
+    static void buildBackups(NextHop* pHops, const vector<double>& distances,
+                             const vector<double>& remaining,
+                             const vector<double>& returns, double shortest,
+                             const vector<LinkLayer*>& links);
+
+    /**
+     * Apskaičiuoja mFromSelf ir mToSelf.
+     */
+    void     neighbourDistances();
+};
+
+#endif
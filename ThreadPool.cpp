@@ -0,0 +1,70 @@
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(unsigned size):
+  mpTask(NULL),
+  mCount(0),
+  mNext(0),
+  mBusy(0),
+  mGeneration(0),
+  mStopping(false)
+{
+  if (size == 0) size = thread::hardware_concurrency();
+  for (unsigned worker = 1; worker < size; worker++)
+  {
+    mThreads.push_back(thread(&ThreadPool::work, this, worker));
+  }
+}
+
+ThreadPool::~ThreadPool()
+{
+  {
+    lock_guard<mutex> lock(mMutex);
+    mStopping = true;
+  }
+  mStart.notify_all();
+  for (auto& rThread : mThreads) rThread.join();
+}
+
+void ThreadPool::run(unsigned count, const Task& rTask)
+{
+  if (count <= 1 || mThreads.empty())
+  { // žadinti gijų neverta
+    for (unsigned task = 0; task < count; task++) rTask(task, 0);
+    return;
+  }
+  {
+    lock_guard<mutex> lock(mMutex);
+    mpTask = &rTask;
+    mCount = count;
+    mNext = 0;
+    mBusy = mThreads.size();
+    mGeneration++;
+  }
+  mStart.notify_all();
+  take(0);
+  unique_lock<mutex> lock(mMutex);
+  while (mBusy > 0) mDone.wait(lock);
+  mpTask = NULL;
+}
+
+void ThreadPool::work(unsigned worker)
+{
+  unsigned generation = 0;
+  unique_lock<mutex> lock(mMutex);
+  while (true)
+  {
+    while (mGeneration == generation && !mStopping) mStart.wait(lock);
+    if (mStopping) return;
+    generation = mGeneration;
+    lock.unlock();
+    take(worker);
+    lock.lock();
+    if (--mBusy == 0) mDone.notify_one();
+  }
+}
+
+void ThreadPool::take(unsigned worker)
+{
+  unsigned task;
+  while ((task = mNext++) < mCount) (*mpTask)(task, worker);
+}
@@ -0,0 +1,64 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include "types.h"
+
+/**
+ * Nedidelis gijų telkinys nepriklausomoms užduotims (pvz., SPF nuo kiekvieno
+ * kaimyno) lygiagrečiai vykdyti.
+ *
+ * run() užduotis 0, 1, ..., count - 1 išdalija gijoms (ir pačiai
+ * kviečiančiajai) po vieną, kaip kuri atsilaisvina, ir grįžta tik visas
+ * įvykdžius. Užduočiai perduodamas ir vykdančiosios gijos numeris
+ * (0 – kviečiančioji, < size()), kad ji galėtų be užraktų naudotis tos gijos
+ * pagalbiniais duomenimis.
+ */
+class ThreadPool
+{
+  public:
+    typedef function<void(unsigned task, unsigned worker)> Task;
+
+  private:
+    vector<thread>     mThreads;
+    mutex              mMutex;
+    condition_variable mStart;
+    condition_variable mDone;
+    const Task*        mpTask;
+    unsigned           mCount;
+    atomic<unsigned>   mNext;       // kita neišdalyta užduotis
+    unsigned           mBusy;       // kiek gijų dar nebaigė šio run()
+    unsigned           mGeneration; // kelintas run()
+    bool               mStopping;
+
+  public:
+    /**
+     * @param size kiek gijų vykdys užduotis kartu su kviečiančiąja; 0 – po
+     *             vieną kiekvienam procesoriaus branduoliui
+     */
+    ThreadPool(unsigned size);
+    ~ThreadPool();
+
+    unsigned size() const { return mThreads.size() + 1; }
+
+    /**
+     * Įvykdo rTask(0, ...), ..., rTask(count - 1, ...) ir grįžta. Tuo pačiu
+     * metu gali vykdyti tik viena gija.
+     */
+    void     run(unsigned count, const Task& rTask);
+
+  private:
+    void     work(unsigned worker);
+
+    /**
+     * Vykdo neišdalytas užduotis, kol jų nebelieka.
+     */
+    void     take(unsigned worker);
+};
+
+#endif
@@ -0,0 +1,232 @@
+#include "TimerWheel.h"
+#include <cstring>
+
+#define NO_ENTRY    0xffffffffU
+#define SLOT_MASK   (TIMER_WHEEL_SLOTS - 1ULL)
+#define LEVEL_SHIFT(level) ((level) * TIMER_WHEEL_BITS)
+
+TimerWheel::TimerWheel():
+  mHeads(LIST_COUNT, NO_ENTRY),
+  mTails(LIST_COUNT, NO_ENTRY),
+  mCurrent(0),
+  mPending(0),
+  mFree(NO_ENTRY)
+{
+  memset(mOccupied, 0, sizeof(mOccupied));
+}
+
+TimerHandle TimerWheel::add(unsigned long long expires, Layer* pLayer,
+                            long long id)
+{
+  unsigned index = mFree;
+  if (index != NO_ENTRY) mFree = mEntries[index].next;
+  else
+  {
+    index = mEntries.size();
+    mEntries.push_back(Entry());
+    mEntries.back().generation = 0;
+  }
+  Entry& rEntry = mEntries[index];
+  rEntry.pLayer = pLayer;
+  rEntry.id = id;
+  rEntry.expires = expires;
+  ++rEntry.generation;
+  insert(index);
+  return ((TimerHandle)rEntry.generation << 32) | (index + 1);
+}
+
+bool TimerWheel::cancel(TimerHandle handle)
+{
+  Entry* pEntry = find(handle);
+  if (pEntry == NULL) return false;
+  unsigned index = pEntry - &mEntries[0];
+  unlink(index);
+  release(index);
+  return true;
+}
+
+bool TimerWheel::reschedule(TimerHandle handle, unsigned long long expires)
+{
+  Entry* pEntry = find(handle);
+  if (pEntry == NULL) return false;
+  unsigned index = pEntry - &mEntries[0];
+  unlink(index);
+  pEntry->expires = expires;
+  insert(index);
+  return true;
+}
+
+bool TimerWheel::expire(unsigned long long now, Layer*& rpLayer, long long& rId)
+{
+  if (mHeads[DUE_LIST] == NO_ENTRY) advance(now);
+  unsigned index = mHeads[DUE_LIST];
+  if (index == NO_ENTRY) return false;
+  rpLayer = mEntries[index].pLayer;
+  rId = mEntries[index].id;
+  unlink(index);
+  release(index);
+  return true;
+}
+
+long long TimerWheel::untilNext(unsigned long long now)
+{
+  if (mHeads[DUE_LIST] != NO_ENTRY) return 0;
+  if (mPending == 0) return -1;
+  unsigned long long next = mCurrent + nextEvent();
+  return next > now ? next - now : 0;
+}
+
+TimerWheel::Entry* TimerWheel::find(TimerHandle handle)
+{
+  unsigned index = (handle & 0xffffffffU) - 1;
+  if (index >= mEntries.size()) return NULL;
+  Entry* pEntry = &mEntries[index];
+  if (pEntry->list == NO_ENTRY || pEntry->generation != (handle >> 32))
+  {
+    return NULL;
+  }
+  return pEntry;
+}
+
+void TimerWheel::insert(unsigned index)
+{
+  unsigned long long expires = mEntries[index].expires;
+  if (expires <= mCurrent)
+  {
+    append(DUE_LIST, index);
+    return;
+  }
+  int level = 0;
+  while (level < TIMER_WHEEL_LEVELS
+         && (expires >> LEVEL_SHIFT(level + 1))
+            != (mCurrent >> LEVEL_SHIFT(level + 1)))
+  {
+    ++level;
+  }
+  unsigned slot;
+  if (level == TIMER_WHEEL_LEVELS)
+  { // toliau nei ratas siekia – į vėliausiai apdorojamą langelį, iš kurio
+    // bus perkeltas dar kartą
+    level = TIMER_WHEEL_LEVELS - 1;
+    slot = ((mCurrent >> LEVEL_SHIFT(level)) - 1) & SLOT_MASK;
+  }
+  else slot = (expires >> LEVEL_SHIFT(level)) & SLOT_MASK;
+  append(level * TIMER_WHEEL_SLOTS + slot, index);
+}
+
+void TimerWheel::append(unsigned list, unsigned index)
+{
+  Entry& rEntry = mEntries[index];
+  rEntry.list = list;
+  rEntry.next = NO_ENTRY;
+  rEntry.prev = mTails[list];
+  if (mTails[list] == NO_ENTRY)
+  {
+    mHeads[list] = index;
+    if (list != DUE_LIST)
+    {
+      mOccupied[list / TIMER_WHEEL_SLOTS][list % TIMER_WHEEL_SLOTS / 64]
+        |= 1ULL << (list % 64);
+    }
+  }
+  else mEntries[mTails[list]].next = index;
+  mTails[list] = index;
+  if (list != DUE_LIST) ++mPending;
+}
+
+void TimerWheel::unlink(unsigned index)
+{
+  Entry& rEntry = mEntries[index];
+  unsigned list = rEntry.list;
+  if (rEntry.prev == NO_ENTRY) mHeads[list] = rEntry.next;
+  else mEntries[rEntry.prev].next = rEntry.next;
+  if (rEntry.next == NO_ENTRY) mTails[list] = rEntry.prev;
+  else mEntries[rEntry.next].prev = rEntry.prev;
+  if (list != DUE_LIST)
+  {
+    --mPending;
+    if (mHeads[list] == NO_ENTRY)
+    {
+      mOccupied[list / TIMER_WHEEL_SLOTS][list % TIMER_WHEEL_SLOTS / 64]
+        &= ~(1ULL << (list % 64));
+    }
+  }
+  rEntry.list = NO_ENTRY;
+}
+
+void TimerWheel::release(unsigned index)
+{
+  mEntries[index].next = mFree;
+  mFree = index;
+}
+
+void TimerWheel::advance(unsigned long long now)
+{
+  while (mCurrent < now)
+  {
+    if (mPending == 0)
+    {
+      mCurrent = now;
+      return;
+    }
+    unsigned long long next = mCurrent + nextEvent();
+    if (next > now)
+    {
+      mCurrent = now;
+      return;
+    }
+    mCurrent = next - 1;
+    tick();
+  }
+}
+
+void TimerWheel::tick()
+{
+  ++mCurrent;
+  for (int level = TIMER_WHEEL_LEVELS - 1; level > 0; --level)
+  {
+    if (mCurrent & ((1ULL << LEVEL_SHIFT(level)) - 1)) continue;
+    unsigned list = level * TIMER_WHEEL_SLOTS
+                    + ((mCurrent >> LEVEL_SHIFT(level)) & SLOT_MASK);
+    for (unsigned index = mHeads[list]; index != NO_ENTRY;)
+    {
+      unsigned next = mEntries[index].next;
+      unlink(index);
+      insert(index);
+      index = next;
+    }
+  }
+  unsigned list = mCurrent & SLOT_MASK;
+  for (unsigned index = mHeads[list]; index != NO_ENTRY;)
+  {
+    unsigned next = mEntries[index].next;
+    unlink(index);
+    append(DUE_LIST, index);
+    index = next;
+  }
+}
+
+unsigned long long TimerWheel::nextEvent()
+{
+  for (int level = 0; level < TIMER_WHEEL_LEVELS; level++)
+  {
+    unsigned current = (mCurrent >> LEVEL_SHIFT(level)) & SLOT_MASK;
+    for (unsigned word = (current + 1) / 64; word < TIMER_WHEEL_SLOTS / 64;
+         word++)
+    {
+      unsigned long long bits = mOccupied[level][word];
+      if (word == (current + 1) / 64 && (current + 1) % 64)
+      {
+        bits &= ~0ULL << ((current + 1) % 64);
+      }
+      if (bits == 0) continue;
+      unsigned long long slot = word * 64 + __builtin_ctzll(bits);
+      unsigned long long blockStart = mCurrent >> LEVEL_SHIFT(level + 1)
+                                               << LEVEL_SHIFT(level + 1);
+      return blockStart + (slot << LEVEL_SHIFT(level)) - mCurrent;
+    }
+  }
+  // liko tik už aukščiausio lygio ribų esantys laikmačiai
+  return (((mCurrent >> LEVEL_SHIFT(TIMER_WHEEL_LEVELS)) + 1)
+          << LEVEL_SHIFT(TIMER_WHEEL_LEVELS)) - mCurrent;
+}
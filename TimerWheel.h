@@ -0,0 +1,104 @@
+#ifndef TIMERWHEEL_H
+#define TIMERWHEEL_H
+
+#include <vector>
+#include "types.h"
+
+#define TIMER_WHEEL_LEVELS   4
+#define TIMER_WHEEL_BITS     8 // kiek laiko bitų tenka vienam lygiui
+#define TIMER_WHEEL_SLOTS  (1 << TIMER_WHEEL_BITS)
+
+class Layer;
+
+/**
+ * Hierarchinis laikmačių ratas.
+ *
+ * Laikas matuojamas milisekundėmis (tiksais). Ratą sudaro TIMER_WHEEL_LEVELS
+ * lygių po TIMER_WHEEL_SLOTS langelių; L-tojo lygio langelis apima
+ * 2^(L * TIMER_WHEEL_BITS) tiksų. Laikmatis dedamas į žemiausią lygį, kurio
+ * ribose jo pabaigos laikas dar skiriasi nuo dabartinio. Kai dabartinis laikas
+ * pasiekia aukštesnio lygio langelio pradžią, to langelio laikmačiai
+ * perkeliami į žemesnius lygius. Pridėjimas, atšaukimas ir perkėlimas kitam
+ * laikui trunka O(1).
+ *
+ * Laikmačiai laikomi viename masyve ir sujungti dvikrypčiais sąrašais pagal
+ * indeksus. Rankenoje (TimerHandle) be indekso užkoduotas ir įrašo kartos
+ * numeris, todėl pasibaigusio ar atšaukto laikmačio rankena nieko nepakeičia.
+ */
+class TimerWheel
+{
+  private:
+    struct Entry
+    {
+      Layer*             pLayer;
+      long long          id;
+      unsigned long long expires;    // pabaigos laikas tiksais
+      unsigned           next;
+      unsigned           prev;
+      unsigned           generation;
+      unsigned           list;       // sąrašas, kuriame yra įrašas
+    };
+
+    enum { DUE_LIST = TIMER_WHEEL_LEVELS * TIMER_WHEEL_SLOTS, LIST_COUNT };
+
+  private:
+    vector<Entry>      mEntries;
+    vector<unsigned>   mHeads;
+    vector<unsigned>   mTails;
+    unsigned long long mOccupied[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS / 64];
+    unsigned long long mCurrent;  // iki kurio tikso ratas pasuktas
+    unsigned           mPending;  // kiek laikmačių laukia langeliuose
+    unsigned           mFree;     // laisvų įrašų sąrašo pradžia
+
+  public:
+    TimerWheel();
+
+    /**
+     * Prideda laikmatį.
+     *
+     * @param expires kuriuo tiksu laikmatis turi baigtis
+     * @param pLayer  lygis, kurio timer() bus iškviesta
+     * @param id      reikšmė, perduodama pLayer->timer()
+     * @return laikmačio rankena (niekada nelygi 0)
+     */
+    TimerHandle add(unsigned long long expires, Layer* pLayer, long long id);
+
+    /**
+     * Atšaukia laikmatį.
+     *
+     * @return true, jei laikmatis dar nebuvo pasibaigęs ar atšauktas
+     */
+    bool        cancel(TimerHandle handle);
+
+    /**
+     * Perkelia laikmatį kitam laikui.
+     *
+     * @return true, jei laikmatis dar nebuvo pasibaigęs ar atšauktas
+     */
+    bool        reschedule(TimerHandle handle, unsigned long long expires);
+
+    /**
+     * Išima vieną iki now pasibaigusį laikmatį.
+     *
+     * @return true, jei toks laikmatis rastas ir įrašytas į rpLayer bei rId
+     */
+    bool        expire(unsigned long long now, Layer*& rpLayer, long long& rId);
+
+    /**
+     * @return po kiek tiksų nuo now reikės pasukti ratą, arba -1, jei
+     *         laikmačių nėra
+     */
+    long long   untilNext(unsigned long long now);
+
+  private:
+    Entry*             find(TimerHandle handle);
+    void               insert(unsigned index);
+    void               append(unsigned list, unsigned index);
+    void               unlink(unsigned index);
+    void               release(unsigned index);
+    void               advance(unsigned long long now);
+    void               tick();
+    unsigned long long nextEvent();
+};
+
+#endif
@@ -1,34 +1,21 @@
 #include "TransportLayer.h"
 #include "Node.h"
 #include <cstdio> // perror
+#include <cstring>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <arpa/inet.h>
 
 TransportLayer::TransportLayer(Node* pNode):
   Layer(pNode),
-  mLastPort(0),
-  mLastTimer(0)
+  mLastPort(0)
 { }
 
 void TransportLayer::timer(long long id)
 {
-  auto it = mTimers.find(id);
-  if (it == mTimers.end()) info("Klaida: nerastas laikmatis %lld.\n", id);
-  else if (it->second->lastTimer == id)
-  {
-    if (NULL == it->second->pSelfDestructMap)
-    {
-      it->second->lastTimer = 0;
-      send(it->second);
-    }
-    else
-    {
-      it->second->pSelfDestructMap->erase(it->second->selfDestructIt);
-      delete it->second;
-    }
-  }
-  mTimers.erase(it);
+  Connection* pConnection = (Connection*)id;
+  pConnection->timer = 0;
+  send(pConnection);
 }
 
 void TransportLayer::fromNetworkLayer(IpAddress source, Byte* tpdu,
@@ -169,8 +156,7 @@ void TransportLayer::fromNetworkLayer(IpAddress source, Byte* tpdu,
                   rApp.blocked = NONE;
                   sendInt(appIt->first, -1);
                   rApp.portToSocket[header.destinationPort].erase(socketIt);
-                  connIt->second->selfDestruct(&rApp.socketToConnection,
-                                               connIt);
+                  destroy(&rApp.socketToConnection, connIt);
                 }
                 else
                 {
@@ -225,10 +211,15 @@ void TransportLayer::addApp(int appSocket)
 
 void TransportLayer::removeApp(int appSocket)
 {
-  if (1 != mApps.erase(appSocket))
+  auto appIt = mApps.find(appSocket);
+  if (mApps.end() == appIt)
   {
     info("Klaida: programa %d jau buvo atjungta.\n", appSocket);
+    return;
   }
+  ConnectionMap& rConnections = appIt->second.socketToConnection;
+  while (!rConnections.empty()) destroy(&rConnections, rConnections.begin());
+  mApps.erase(appIt);
 }
 
 void TransportLayer::appAction(int appSocket, unsigned char action)
@@ -465,7 +456,7 @@ void TransportLayer::appAction(int appSocket, unsigned char action)
         else if (connIt->second->remoteDisconnected)
         {
           info("[close] Programa %d nutraukė jungtį %d.\n", appSocket, socket);
-          connIt->second->selfDestruct(&rApp.socketToConnection, connIt);
+          destroy(&rApp.socketToConnection, connIt);
           sendByte(appSocket, true);
         }
         else
@@ -625,9 +616,9 @@ void TransportLayer::reject(IpAddress destination, Header header)
   header.ack = header.syn + 1;
   header.syn = 0;
   header.type = 3;
-  Byte buffer[sizeof(Header)];
-  header.toBytes(buffer);
-  mpNode->toNetworkLayer(destination, buffer, sizeof(Header));
+  PacketBuffer segment(sizeof(Header));
+  header.toBytes(segment.data());
+  mpNode->toNetworkLayer(destination, segment);
 }
 
 Byte TransportLayer::checksum(Byte* data, int length)
@@ -658,24 +649,31 @@ void TransportLayer::send(Connection* pConnection)
   auto length = min((unsigned long)(min(pConnection->congestionWindow,
                                         pConnection->window)),
                     pConnection->sndQueue.size());
-  Byte buffer[sizeof(Header) + length];
-  for (unsigned long i = 0; i < length; i++)
-  {
-    buffer[sizeof(Header) + i] = pConnection->sndQueue[i];
-  }
+  PacketBuffer segment(sizeof(Header) + length);
+  Byte* buffer = segment.data();
+  copy(pConnection->sndQueue.begin(), pConnection->sndQueue.begin() + length,
+       buffer + sizeof(Header));
   pConnection->header.checksum = 0;
   pConnection->header.toBytes(buffer);
   pConnection->header.checksum = checksum(buffer, sizeof(Header) + length);
-  pConnection->header.toBytes(buffer);
-  mpNode->toNetworkLayer(pConnection->remoteIp, buffer,
-                         sizeof(Header) + length);
+  buffer[SEGMENT_CHECKSUM] = pConnection->header.checksum;
+  mpNode->toNetworkLayer(pConnection->remoteIp, segment);
   pConnection->header.type = type;
   startTimer(pConnection, RTO);
 }
 
 void TransportLayer::startTimer(Connection* pConnection, int timeout)
 {
-  mTimers.insert(make_pair(++mLastTimer, pConnection));
-  pConnection->lastTimer = mLastTimer;
-  mpNode->startTimer(this, timeout, mLastTimer);
+  if (!mpNode->restartTimer(pConnection->timer, timeout))
+  {
+    pConnection->timer = mpNode->startTimer(this, timeout,
+                                            (long long)pConnection);
+  }
+}
+
+void TransportLayer::destroy(ConnectionMap* pMap, ConnectionMap::iterator it)
+{
+  mpNode->cancelTimer(it->second->timer);
+  delete it->second;
+  pMap->erase(it);
 }
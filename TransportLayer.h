@@ -2,6 +2,7 @@
 #define TRANSPORTLAYER_H
 
 #include "Layer.h"
+#include "PacketBuffer.h"
 #include <unordered_map>
 #include <queue>
 #include <vector>
@@ -15,6 +16,7 @@
 #define MAX_LISTEN_QUEUE 10 // kiek daugiau klientų gali eilėje laukti accept()
 #define SEGMENT_ACK_TIMEOUT 1000 // kiek milisekundžių laukia iki ACK
                                  // išsiuntimo, kai siuntimo eilė tuščia
+#define SEGMENT_CHECKSUM 15 // kontrolinės sumos vieta antraštėje
 
 class Node;
 
@@ -78,7 +80,7 @@ class TransportLayer: public Layer
         ack             = bytes_to_int(bytes + 8);
         window          = bytes_to_short(bytes + 12);
         type            = bytes[14];
-        checksum        = bytes[15];
+        checksum        = bytes[SEGMENT_CHECKSUM];
       }
 
       void toBytes(Byte* bytes)
@@ -89,7 +91,7 @@ class TransportLayer: public Layer
         int_to_bytes(bytes + 8, ack);
         short_to_bytes(bytes + 12, window);
         bytes[14] = type;
-        bytes[15] = checksum;
+        bytes[SEGMENT_CHECKSUM] = checksum;
       }
     };
 
@@ -101,12 +103,10 @@ class TransportLayer: public Layer
       unsigned short          window; // gautas siuntimo langas
       vector<Byte>            sndQueue;
       vector<Byte>            rcvQueue;
-      long long               lastTimer;
+      TimerHandle             timer; // laikmačio id – jungties adresas
       bool                    remoteDisconnected : 1;
       Header                  header; // paskutinio išsiųsto segmento antraštė
-      ConnectionMap*          pSelfDestructMap;
-      ConnectionMap::iterator selfDestructIt;
-      
+
 
       Connection(TransportLayer* pTransportLayer, Port myPort, IpAddress ip,
                  Port theirPort, unsigned char type, unsigned char ack = 0):
@@ -114,9 +114,8 @@ class TransportLayer: public Layer
         threshold(0),
         congestionWindow(MAX_SEGMENT_SIZE - sizeof(Header)),
         window(0),
-        lastTimer(0),
-        remoteDisconnected(false),
-        pSelfDestructMap(NULL)
+        timer(0),
+        remoteDisconnected(false)
       {
         header.sourcePort      = myPort;
         header.destinationPort = theirPort;
@@ -128,17 +127,6 @@ class TransportLayer: public Layer
         // FIXME: po nulūžimo gali pasirinkti blogą SYN
         pTransportLayer->send(this);
       }
-
-      void selfDestruct(ConnectionMap* pMap, ConnectionMap::iterator it)
-      {
-        if (lastTimer)
-        {
-          pSelfDestructMap = pMap;
-          selfDestructIt = it;
-        }
-        pMap->erase(it);
-        delete this;
-      }
     };
 
     struct App
@@ -162,8 +150,6 @@ class TransportLayer: public Layer
     unordered_map<int, App>               mApps;
     unordered_map<Port, int>              mPortToApp;
     Port                                  mLastPort;
-    unordered_map<long long, Connection*> mTimers;
-    long long                             mLastTimer;
 
   public:
     TransportLayer(Node* pNode);
@@ -199,6 +185,11 @@ class TransportLayer: public Layer
     void reject(IpAddress destination, Header header);
     void startTimer(Connection* pConnection, int timeout);
 
+    /**
+     * Atšaukia jungties laikmatį, ją sunaikina ir pašalina iš pMap.
+     */
+    void destroy(ConnectionMap* pMap, ConnectionMap::iterator it);
+
     static Byte checksum(Byte* data, int length);
 };
 
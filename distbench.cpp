@@ -0,0 +1,126 @@
+/**
+ * Atstumų lentelių atminties palyginimas.
+ *
+ * Naudojimas: distbench [mazgų skaičius ...]
+ * Maršrutams skaičiuoti kiekvienam kaimynui laikoma atstumų iki visų srities
+ * mazgų lentelė. Programa užpildo tokią lentelę (numatyta – 1000, 10000 ir
+ * 100000 mazgų) trimis būdais:
+ * maiša  – kaip NetworkLayer iki tankių numerių: unordered_map<IpAddress,
+ *          Distance> su 64 bitų atstumu;
+ * plati  – masyvas pagal mazgo numerį su tais pačiais laukais;
+ * siaura – RouteWorker::DistanceTable (4 baitai: 24 bitų atstumas ir MTU
+ *          FRAGMENT_CHUNK dalimis; šuolių skaičius įvertinamas pagal
+ *          atstumą, ankstesnis mazgas nesaugomas).
+ * Išveda, kiek baitų tenka vienam mazgui ir kiek užimtų BENCH_NEIGHBOURS
+ * kaimynų lentelės. Maišos lentelės atmintis skaičiuojama pagal išskirtų
+ * blokų dydžius, be malloc antraščių, taigi iš tikrųjų ji dar didesnė.
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include <unordered_map>
+
+#include "RouteWorker.h"
+
+#define BENCH_NEIGHBOURS 32
+
+struct WideDistance
+{
+  unsigned long long delay;
+  unsigned           hops;
+  unsigned           parent;
+  unsigned           mtu;
+};
+
+static size_t gAllocated = 0; // CountingAllocator išskirta baitų
+
+template <class T>
+struct CountingAllocator
+{
+  typedef T value_type;
+
+  CountingAllocator() { }
+  template <class U> CountingAllocator(const CountingAllocator<U>&) { }
+
+  T* allocate(size_t count)
+  {
+    gAllocated += count * sizeof(T);
+    return static_cast<T*>(::operator new(count * sizeof(T)));
+  }
+
+  void deallocate(T* p, size_t count)
+  {
+    gAllocated -= count * sizeof(T);
+    ::operator delete(p);
+  }
+};
+
+template <class T, class U>
+bool operator == (const CountingAllocator<T>&, const CountingAllocator<U>&)
+{
+  return true;
+}
+
+template <class T, class U>
+bool operator != (const CountingAllocator<T>&, const CountingAllocator<U>&)
+{
+  return false;
+}
+
+typedef unordered_map<IpAddress, WideDistance, hash<IpAddress>,
+                      equal_to<IpAddress>,
+                      CountingAllocator<pair<const IpAddress, WideDistance> > >
+        DistanceMap;
+
+static double megabytes(double bytes)
+{
+  return bytes * BENCH_NEIGHBOURS / (1024 * 1024);
+}
+
+static void run(unsigned nodeCount)
+{
+  double mapBytes, wideBytes, narrowBytes;
+  {
+    DistanceMap distances;
+    for (unsigned i = 0; i < nodeCount; i++)
+    {
+      WideDistance distance = { (unsigned long long)rand(), i % 64, i, 1500 };
+      distances[0x0a000000 + i] = distance;
+    }
+    mapBytes = gAllocated;
+  }
+  vector<WideDistance> wide(nodeCount);
+  RouteWorker::DistanceTable narrow(nodeCount);
+  for (unsigned i = 0; i < nodeCount; i++)
+  {
+    WideDistance distance = { (unsigned long long)rand(), i % 64, i, 1500 };
+    wide[i] = distance;
+    narrow[i].delay = wide[i].delay % UNREACHABLE;
+    narrow[i].setMtu(wide[i].mtu);
+  }
+  wideBytes = wide.capacity() * sizeof(WideDistance);
+  narrowBytes = narrow.capacity() * sizeof(RouteWorker::Distance);
+  printf("%7u mazgų: maiša %5.1f B/mazgui, plati %4.1f, siaura %4.1f; "
+         "%u kaimynų – %7.1f / %6.1f / %6.1f MB (%.1fx)\n",
+         nodeCount, mapBytes / nodeCount, wideBytes / nodeCount,
+         narrowBytes / nodeCount, BENCH_NEIGHBOURS, megabytes(mapBytes),
+         megabytes(wideBytes), megabytes(narrowBytes),
+         mapBytes / narrowBytes);
+}
+
+int main(int argc, char* argv[])
+{
+  srand(1);
+  if (argc > 1)
+  {
+    for (int i = 1; i < argc; i++) run(strtoul(argv[i], NULL, 10));
+  }
+  else
+  {
+    for (unsigned nodeCount = 1000; nodeCount <= 100000; nodeCount *= 10)
+    {
+      run(nodeCount);
+    }
+  }
+  return 0;
+}
@@ -8,7 +8,8 @@ namespace std
   {
     size_t operator()(pair<IpAddress, unsigned short> x) const throw()
     {
-      return hash<long long>()(((long long)(x.first) << sizeof(unsigned short))
+      return hash<long long>()(((long long)(x.first)
+                                << (8 * sizeof(unsigned short)))
                                + x.second);
     }
   };
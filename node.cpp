@@ -3,15 +3,31 @@
  * Mazgus galima sujungti laidais. Programos gali naudotis jų tinklo paslauga,
  * naudodamos biblioteką, kuri dar nerealizuota.
  *
- * Naudojimas: node [pavadinimas] mac ip
+ * Naudojimas: node [parinktys] [pavadinimas] mac ip
  * Jei pavadinimas nenurodomas, jis sutapatinamas su mac adresu.
  * mac – mazgo aparatinis adresas, susidedantis iš 12 šešioliktainių skaitmenų,
  *       galimai atskirtų minusais arba dvitaškiais;
  * ip  – mazgo tinklo adresas, pateiktas įprastu IPv4 formatu
+ * Parinktys (žr. Config.h):
+ * -q n – kanalinio lygio duomenų kadrų eilės ilgis;
+ * -c n – kanalinio lygio valdymo kadrų eilės ilgis;
+ * -p n – kiek paketų tinklo lygis laiko kiekvienam kaimynui, kol jo eilė pilna;
+ * -m n – didžiausias mazgo kanalais siunčiamo paketo ilgis (MTU);
+ * -r n – kiek baitų atminties skirti fragmentais gaunamų paketų surinkimui;
+ * -s n – po kiek milisekundžių nuo pirmo LS pasikeitimo skaičiuoti maršrutus;
+ * -w n – pradinis mažiausias laikas tarp maršrutų skaičiavimų;
+ * -W n – didžiausias laikas tarp maršrutų skaičiavimų;
+ * -a n – kiek pirmųjų ip adreso bitų nurodo mazgo sritį (1–32; visuose
+ *        mazguose vienodai);
+ * -t n – kiek gijų skaičiuoja maršrutus (numatyta – kiek procesoriaus
+ *        branduolių);
+ * -i n – kas kiek milisekundžių siųsti kaimynams gyvumo kadrus;
+ * -I n – po kiek intervalų be jokio kadro kaimynas laikomas prapuolusiu.
  */
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <climits>
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/socket.h>
@@ -23,12 +39,34 @@
 
 #define BACKLOG             10 // maksimalus prisijungimų prie lizdo eilės ilgis
 #define HEXS_IN_MAC_ADDRESS 12 // šešioliktainių simbolių MAC adrese kiekis
-#define USAGE_INFO "Naudojimas: node [pavadinimas] adresas\nJei pavadinimas nenurodomas, jis sutapatinamas su mac adresu.\n\
+#define USAGE_INFO "Naudojimas: node [parinktys] [pavadinimas] adresas\nJei pavadinimas nenurodomas, jis sutapatinamas su mac adresu.\n\
                     mac – mazgo aparatinis adresas, susidedantis iš 12\n\
                           šešioliktainių skaitmenų,\n\
                           galimai atskirtų minusais arba dvitaškiais;\n\
                     ip  – mazgo tinklo adresas, pateiktas įprastu IPv4\n\
-                          formatu.\n"
+                          formatu.\n\
+Parinktys:\n\
+                    -q n – kanalinio lygio duomenų kadrų eilės ilgis;\n\
+                    -c n – kanalinio lygio valdymo kadrų eilės ilgis;\n\
+                    -p n – kiek paketų tinklo lygis laiko kiekvienam\n\
+                           kaimynui, kol jo eilė pilna;\n\
+                    -m n – didžiausias mazgo kanalais siunčiamo paketo\n\
+                           ilgis (MTU);\n\
+                    -r n – kiek baitų atminties skirti fragmentais\n\
+                           gaunamų paketų surinkimui;\n\
+                    -s n – po kiek milisekundžių nuo pirmo LS\n\
+                           pasikeitimo skaičiuoti maršrutus;\n\
+                    -w n – pradinis mažiausias laikas tarp maršrutų\n\
+                           skaičiavimų;\n\
+                    -W n – didžiausias laikas tarp maršrutų skaičiavimų;\n\
+                    -a n – kiek pirmųjų ip adreso bitų nurodo mazgo\n\
+                           sritį (1–32; visuose mazguose vienodai);\n\
+                    -t n – kiek gijų skaičiuoja maršrutus (numatyta –\n\
+                           kiek procesoriaus branduolių);\n\
+                    -i n – kas kiek milisekundžių siųsti kaimynams\n\
+                           gyvumo kadrus;\n\
+                    -I n – po kiek intervalų be jokio kadro kaimynas\n\
+                           laikomas prapuolusiu.\n"
 
 using namespace std;
 
@@ -106,9 +144,73 @@ MacAddress parse_mac_address(char* macStr)
   return macAddress;
 }
 
+/**
+ * Paverčia simbolių eilutę teigiamu sveikuoju skaičiumi.
+ *
+ * @param str    dešimtainis skaičius
+ * @param pValue kur įrašyti rezultatą
+ * @return true, jei eilutė taisyklinga
+ */
+bool parse_positive(const char* str, unsigned* pValue)
+{
+  char* end;
+  unsigned long value = strtoul(str, &end, 10);
+  if (*str == '\0' || *end != '\0' || value == 0 || value > UINT_MAX)
+  {
+    return false;
+  }
+  *pValue = value;
+  return true;
+}
+
+/**
+ * Nuskaito parinktis į rConfig ir pastumia argv iki pirmo kito argumento.
+ *
+ * @return true, jei visos parinktys taisyklingos
+ */
+bool parse_options(int& rArgc, char**& rArgv, Config& rConfig)
+{
+  int option;
+  while (-1 != (option = getopt(rArgc, rArgv, "q:c:p:m:r:s:w:W:a:t:i:I:")))
+  {
+    bool valid;
+    switch (option)
+    {
+      case 'q': valid = parse_positive(optarg, &rConfig.frameQueueSize);   break;
+      case 'c': valid = parse_positive(optarg, &rConfig.controlQueueSize); break;
+      case 'p': valid = parse_positive(optarg, &rConfig.pendingQueueSize); break;
+      case 'm': valid = parse_positive(optarg, &rConfig.mtu)
+                        && rConfig.mtu >= MIN_MTU && rConfig.mtu <= MAX_MTU;
+                break;
+      case 'r': valid = parse_positive(optarg, &rConfig.reassemblyMemory);
+                break;
+      case 's': valid = parse_positive(optarg, &rConfig.spfDelay);         break;
+      case 'w': valid = parse_positive(optarg, &rConfig.spfHold);          break;
+      case 'W': valid = parse_positive(optarg, &rConfig.spfMaxHold);       break;
+      case 'a': valid = parse_positive(optarg, &rConfig.areaPrefix)
+                        && rConfig.areaPrefix <= 32;
+                break;
+      case 't': valid = parse_positive(optarg, &rConfig.spfThreads);       break;
+      case 'i': valid = parse_positive(optarg, &rConfig.helloInterval);    break;
+      case 'I': valid = parse_positive(optarg, &rConfig.helloMultiplier);  break;
+      default:  valid = false;
+    }
+    if (!valid) return false;
+  }
+  rArgc -= optind - 1; // kaip be parinkčių: argv[1] – pirmas argumentas
+  rArgv += optind - 1;
+  return true;
+}
+
 int main(int argc, char* argv[])
 {
   srand(time(NULL));
+  Config config;
+  if (!parse_options(argc, argv, config))
+  {
+    printf(USAGE_INFO);
+    return 1;
+  }
   if (argc < 3 || argc > 4)
   {
     printf(USAGE_INFO);
@@ -158,7 +260,7 @@ int main(int argc, char* argv[])
     return 1;
   }
 
-  gpNode = new Node(gWireSocket, gAppSocket, macAddress, ipAddress);
+  gpNode = new Node(gWireSocket, gAppSocket, macAddress, ipAddress, config);
   printf("Startuoja...\n");
   gpNode->run();
   printf("Finišuoja...\n");
@@ -0,0 +1,168 @@
+/**
+ * Trumpiausių kelių skaičiavimo greičio palyginimas.
+ *
+ * Naudojimas: spfbench [mazgų skaičius ...]
+ * Sugeneruoja atsitiktinius grafus (numatyta – 1000, 10000 ir 100000 mazgų,
+ * kiekvienas turi vidutiniškai BENCH_DEGREE kaimynų) ir iš kelių šaknų
+ * skaičiuoja atstumus dviem būdais:
+ * multimap – kaip NetworkLayer iki tankių numerių: kaimynai ir atstumai
+ *            maišos lentelėse, eilė – multimap su pasenusiais įrašais;
+ * krūva    – tankūs numeriai, kaimynai CSR masyvuose, atstumai vektoriuje,
+ *            eilė – IndexedHeap su rakto mažinimu.
+ * Išveda vidutinę vieno skaičiavimo trukmę ir patikrina, ar rezultatai sutampa.
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <map>
+#include <vector>
+#include <unordered_map>
+
+#include "IndexedHeap.h"
+
+#define BENCH_DEGREE    4
+#define BENCH_MAX_DELAY 1000
+#define BENCH_ROOTS     5
+#define INFINITE_DELAY  0xffffffffffffffffULL
+
+typedef unordered_map<IpAddress, vector<pair<IpAddress, unsigned> > > Graph;
+
+struct CsrGraph
+{
+  vector<unsigned> offsets; // mazgo i briaunos – [offsets[i]; offsets[i + 1])
+  vector<unsigned> targets;
+  vector<unsigned> weights;
+};
+
+static double elapsed_ms(const timespec& rStart)
+{
+  timespec current;
+  clock_gettime(CLOCK_MONOTONIC, &current);
+  current = current - rStart;
+  return current.tv_sec * 1000.0 + current.tv_nsec / 1e6;
+}
+
+/**
+ * Sugeneruoja grafą su IP adresais 10.0.0.0 + i ir jį atitinkantį CSR grafą.
+ * Žiedas užtikrina, kad visi mazgai pasiekiami.
+ */
+static void generate(unsigned nodeCount, Graph& rGraph, CsrGraph& rCsr)
+{
+  rCsr.offsets.assign(1, 0);
+  for (unsigned i = 0; i < nodeCount; i++)
+  {
+    auto& rNeighbours = rGraph[0x0a000000 + i];
+    rNeighbours.push_back(make_pair(0x0a000000 + (i + 1) % nodeCount,
+                                    rand() % BENCH_MAX_DELAY));
+    for (int j = 1; j < BENCH_DEGREE; j++)
+    {
+      rNeighbours.push_back(make_pair(0x0a000000 + rand() % nodeCount,
+                                      rand() % BENCH_MAX_DELAY));
+    }
+    for (auto& rEdge : rNeighbours)
+    {
+      rCsr.targets.push_back(rEdge.first - 0x0a000000);
+      rCsr.weights.push_back(rEdge.second);
+    }
+    rCsr.offsets.push_back(rCsr.targets.size());
+  }
+}
+
+static void spf_multimap(Graph& rGraph, IpAddress root,
+                         unordered_map<IpAddress, unsigned long long>& rDist)
+{
+  rDist.clear();
+  multimap<unsigned long long, IpAddress> priorityQueue;
+  rDist[root] = 0;
+  priorityQueue.insert(make_pair(0, root));
+  for (; !priorityQueue.empty(); priorityQueue.erase(priorityQueue.begin()))
+  {
+    IpAddress current = priorityQueue.begin()->second;
+    unsigned long long distance = rDist.find(current)->second;
+    if (distance < priorityQueue.begin()->first) continue;
+    for (auto& rEdge : rGraph[current])
+    {
+      unsigned long long newDistance = distance + rEdge.second;
+      auto it = rDist.find(rEdge.first);
+      if (it == rDist.end())
+      {
+        rDist.insert(make_pair(rEdge.first, newDistance));
+      }
+      else if (newDistance < it->second) it->second = newDistance;
+      else continue;
+      priorityQueue.insert(make_pair(newDistance, rEdge.first));
+    }
+  }
+}
+
+static void spf_heap(const CsrGraph& rCsr, unsigned root, IndexedHeap& rQueue,
+                     vector<unsigned long long>& rDist)
+{
+  rDist.assign(rCsr.offsets.size() - 1, INFINITE_DELAY);
+  rDist[root] = 0;
+  rQueue.push(root, 0);
+  while (!rQueue.empty())
+  {
+    unsigned long long distance;
+    unsigned current = rQueue.pop(&distance);
+    for (unsigned e = rCsr.offsets[current]; e < rCsr.offsets[current + 1]; e++)
+    {
+      unsigned long long newDistance = distance + rCsr.weights[e];
+      if (newDistance < rDist[rCsr.targets[e]])
+      {
+        rDist[rCsr.targets[e]] = newDistance;
+        rQueue.push(rCsr.targets[e], newDistance);
+      }
+    }
+  }
+}
+
+static bool run(unsigned nodeCount)
+{
+  Graph graph;
+  CsrGraph csr;
+  generate(nodeCount, graph, csr);
+  unordered_map<IpAddress, unsigned long long> mapDist;
+  vector<unsigned long long> heapDist;
+  IndexedHeap queue;
+  double mapTime = 0, heapTime = 0;
+  bool same = true;
+  for (int i = 0; i < BENCH_ROOTS; i++)
+  {
+    unsigned root = rand() % nodeCount;
+    timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    spf_multimap(graph, 0x0a000000 + root, mapDist);
+    mapTime += elapsed_ms(start);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    spf_heap(csr, root, queue, heapDist);
+    heapTime += elapsed_ms(start);
+    for (unsigned j = 0; j < nodeCount && same; j++)
+    {
+      auto it = mapDist.find(0x0a000000 + j);
+      same = it != mapDist.end() && it->second == heapDist[j];
+    }
+  }
+  printf("%7u mazgų: multimap %9.3f ms, krūva %8.3f ms (%.1fx)%s\n",
+         nodeCount, mapTime / BENCH_ROOTS, heapTime / BENCH_ROOTS,
+         mapTime / heapTime, same ? "" : " REZULTATAI NESUTAMPA");
+  return same;
+}
+
+int main(int argc, char* argv[])
+{
+  srand(1);
+  bool ok = true;
+  if (argc > 1)
+  {
+    for (int i = 1; i < argc; i++) ok = run(strtoul(argv[i], NULL, 10)) && ok;
+  }
+  else
+  {
+    for (unsigned nodeCount = 1000; nodeCount <= 100000; nodeCount *= 10)
+    {
+      ok = run(nodeCount) && ok;
+    }
+  }
+  return ok ? 0 : 1;
+}
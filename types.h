@@ -13,6 +13,7 @@ typedef unsigned       IpAddress;
 typedef long long      MacAddress;
 typedef unsigned char  Byte;
 typedef unsigned short FrameLength;
+typedef unsigned long long TimerHandle; // žr. TimerWheel.h
 
 void int_to_bytes(Byte* bytes, unsigned num);
 unsigned bytes_to_int(Byte* bytes);